@@ -0,0 +1,71 @@
+#pragma once
+#ifndef COCORO_BENCH_H
+#define COCORO_BENCH_H 1
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string_view>
+#include <vector>
+#include <print>
+#include <utility>
+
+namespace cocoro::bench {
+
+    // Counts every global operator new, see main.cpp
+    inline std::atomic<std::uint64_t> allocation_count = 0;
+
+    template<typename T>
+    inline void do_not_optimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Run `fn` for `iterations` rounds of `batch` operations each,
+    // report time and allocations per operation.
+    template<typename Fn>
+    void measure_batch(std::string_view name, std::size_t iterations, std::size_t batch, Fn&& fn) {
+        using clock = std::chrono::steady_clock;
+        const std::uint64_t allocs_before = allocation_count.load(std::memory_order_relaxed);
+        const auto start = clock::now();
+        for (std::size_t i = 0; i < iterations; ++i) {
+            fn();
+        }
+        const auto stop = clock::now();
+        const std::uint64_t allocs = allocation_count.load(std::memory_order_relaxed) - allocs_before;
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+        const double operations = static_cast<double>(iterations) * batch;
+        std::println("{:<48} {:>12.2f} ns/op {:>10.3f} allocs/op",
+            name, ns / operations, static_cast<double>(allocs) / operations);
+    }
+
+    template<typename Fn>
+    void measure(std::string_view name, std::size_t iterations, Fn&& fn) {
+        measure_batch(name, iterations, 1, std::forward<Fn>(fn));
+    }
+
+    // Run `fn` once, which performs `operations` operations, and report per operation.
+    template<typename Fn>
+    void measure_once(std::string_view name, std::size_t operations, Fn&& fn) {
+        measure_batch(name, 1, operations, std::forward<Fn>(fn));
+    }
+
+    struct benchmark {
+        std::string_view name;
+        void (*run)();
+    };
+
+    inline std::vector<benchmark>& registry() {
+        static std::vector<benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    struct registrar {
+        registrar(std::string_view name, void (*run)()) {
+            registry().push_back({ name, run });
+        }
+    };
+
+} // namespace cocoro::bench
+
+#endif // COCORO_BENCH_H
@@ -0,0 +1,82 @@
+#include "bench.hpp"
+
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <string>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+
+namespace {
+
+    constexpr int depth = 64;
+    constexpr std::size_t captures = 100'000;
+
+    // Captures traces of type Trace at the bottom of a chain of `remaining + 1` frames.
+    template<typename Trace>
+    cocoro::task<std::size_t> capture_chain(int remaining) {
+        if (remaining != 0) {
+            co_return co_await capture_chain<Trace>(remaining - 1);
+        }
+        std::size_t sink = 0;
+        for (std::size_t i = 0; i < captures; ++i) {
+            const Trace trace = co_await Trace::current();
+            for (const auto& entry : trace) {
+                sink += entry.source_line();
+            }
+        }
+        co_return sink;
+    }
+
+    // Formats the trace captured at the bottom of a chain of `remaining + 1` frames into a reused buffer.
+    template<typename Trace>
+    cocoro::task<std::size_t> format_chain(int remaining) {
+        if (remaining != 0) {
+            co_return co_await format_chain<Trace>(remaining - 1);
+        }
+        const Trace trace = co_await Trace::current();
+        std::string buffer;
+        std::size_t sink = 0;
+        for (std::size_t i = 0; i < captures; ++i) {
+            buffer.clear();
+            std::format_to(std::back_inserter(buffer), "{}", trace);
+            sink += buffer.size();
+        }
+        co_return sink;
+    }
+
+    cocoro::detached_task drive(cocoro::task<std::size_t> chain, std::size_t& sink) {
+        sink = co_await std::move(chain);
+    }
+
+    template<typename Trace>
+    void measure_capture(std::string_view name) {
+        std::size_t sink = 0;
+        cocoro::bench::measure_once(std::format("capture and walk {}, depth {}", name, depth), captures, [&] {
+            // chain frames plus the driving detached task
+            drive(capture_chain<Trace>(depth - 2), sink).start();
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    template<typename Trace>
+    void measure_format(std::string_view name) {
+        std::size_t sink = 0;
+        cocoro::bench::measure_once(std::format("format {}, depth {}", name, depth), captures, [&] {
+            drive(format_chain<Trace>(depth - 2), sink).start();
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    void run() {
+        measure_capture<cocoro::corotrace>("corotrace");
+        measure_capture<cocoro::corotrace_view>("corotrace_view");
+        measure_capture<cocoro::inline_corotrace<depth>>("inline_corotrace");
+        measure_format<cocoro::corotrace>("corotrace");
+        measure_format<cocoro::corotrace_view>("corotrace_view");
+    }
+
+    const cocoro::bench::registrar registered("corotrace", &run);
+
+} // namespace
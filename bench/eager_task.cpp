@@ -0,0 +1,67 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <format>
+#include <string>
+#include <string_view>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/eager_task.hpp"
+#include "cocoro/task.hpp"
+#include "cocoro/thread_pool.hpp"
+
+namespace {
+
+    constexpr std::size_t lookups = 1'000'000;
+    constexpr int depth = 4;
+
+    // Outlives the pool, a driver may still be notifying after the waiter returned.
+    constinit std::atomic<bool> done = false;
+
+    // A cache lookup that misses once every `miss_every` calls, a miss hops through the pool.
+    template<template<typename> typename Task>
+    Task<std::size_t> lookup(cocoro::thread_pool& pool, std::size_t key, std::size_t miss_every, int level) {
+        if (level != 0) {
+            co_return co_await lookup<Task>(pool, key, miss_every, level - 1) + 1;
+        }
+        if (miss_every != 0 && key % miss_every == 0) {
+            co_await pool.schedule();
+        }
+        co_return key;
+    }
+
+    template<template<typename> typename Task>
+    cocoro::detached_task drive(cocoro::thread_pool& pool, std::size_t miss_every,
+        std::size_t& sink) {
+        co_await pool.schedule();
+        for (std::size_t key = 1; key <= lookups; ++key) {
+            sink += co_await lookup<Task>(pool, key, miss_every, depth);
+        }
+        done.store(true, std::memory_order_release);
+        done.notify_one();
+    }
+
+    template<template<typename> typename Task>
+    void measure_chain(std::string_view name, cocoro::thread_pool& pool, std::size_t miss_every) {
+        std::size_t sink = 0;
+        const auto hits = miss_every == 0 ? std::string("all hits") : std::format("1/{} misses", miss_every);
+        cocoro::bench::measure_once(std::format("{}, chain of depth {}, {}", name, depth + 1, hits), lookups, [&] {
+            done.store(false, std::memory_order_relaxed);
+            drive<Task>(pool, miss_every, sink).start();
+            done.wait(false, std::memory_order_acquire);
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    void run() {
+        cocoro::thread_pool pool;
+        for (const std::size_t miss_every : { 0, 64, 8 }) {
+            measure_chain<cocoro::task>("task", pool, miss_every);
+            measure_chain<cocoro::eager_task>("eager_task", pool, miss_every);
+        }
+    }
+
+    const cocoro::bench::registrar registered("eager_task", &run);
+
+} // namespace
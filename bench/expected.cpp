@@ -0,0 +1,93 @@
+#include "bench.hpp"
+
+#include <cstddef>
+#include <expected>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+
+// Cost of an error travelling up a chain of tasks, one error in `miss_every` lookups.
+namespace {
+
+    constexpr std::size_t lookups = 1'000'000;
+    constexpr int depth = 8;
+
+    enum class lookup_error { not_found };
+
+    cocoro::task<int> throwing_lookup(std::size_t key, std::size_t miss_every, int level) {
+        if (level != 0) {
+            co_return co_await throwing_lookup(key, miss_every, level - 1) + 1;
+        }
+        if (key % miss_every == 0) {
+            throw std::out_of_range("not found");
+        }
+        co_return 0;
+    }
+
+    cocoro::task<std::expected<int, lookup_error>> checked_lookup(std::size_t key, std::size_t miss_every, int level) {
+        if (level != 0) {
+            auto result = co_await checked_lookup(key, miss_every, level - 1);
+            if (!result) {
+                co_return std::unexpected(result.error());
+            }
+            co_return *result + 1;
+        }
+        if (key % miss_every == 0) {
+            co_return std::unexpected(lookup_error::not_found);
+        }
+        co_return 0;
+    }
+
+    cocoro::task<std::expected<int, lookup_error>> early_return_lookup(std::size_t key, std::size_t miss_every, int level) {
+        if (level != 0) {
+            co_return co_await cocoro::try_await(early_return_lookup(key, miss_every, level - 1)) + 1;
+        }
+        if (key % miss_every == 0) {
+            co_return std::unexpected(lookup_error::not_found);
+        }
+        co_return 0;
+    }
+
+    cocoro::detached_task drive_throwing(std::size_t miss_every, std::size_t& misses) {
+        for (std::size_t key = 1; key <= lookups; ++key) {
+            try {
+                co_await throwing_lookup(key, miss_every, depth);
+            } catch (const std::out_of_range&) {
+                ++misses;
+            }
+        }
+    }
+
+    template<auto Lookup>
+    cocoro::detached_task drive_expected(std::size_t miss_every, std::size_t& misses) {
+        for (std::size_t key = 1; key <= lookups; ++key) {
+            if (!co_await Lookup(key, miss_every, depth)) {
+                ++misses;
+            }
+        }
+    }
+
+    template<typename Drive>
+    void measure_errors(std::string_view name, std::size_t miss_every, Drive drive) {
+        std::size_t misses = 0;
+        cocoro::bench::measure_once(std::format("{}, depth {}, 1/{} misses", name, depth + 1, miss_every), lookups, [&] {
+            drive(miss_every, misses).start();
+        });
+        cocoro::bench::do_not_optimize(misses);
+    }
+
+    void run() {
+        for (const std::size_t miss_every : { 64, 8, 1 }) {
+            measure_errors("exception", miss_every, &drive_throwing);
+            measure_errors("expected, checked per level", miss_every, &drive_expected<&checked_lookup>);
+            measure_errors("expected, try_await", miss_every, &drive_expected<&early_return_lookup>);
+        }
+    }
+
+    const cocoro::bench::registrar registered("expected", &run);
+
+} // namespace
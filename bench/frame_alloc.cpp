@@ -0,0 +1,94 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <print>
+#include <thread>
+#include <vector>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+
+namespace {
+
+    // Same shape as example_nested_task, repeated `depth` times.
+    cocoro::task<int> pooled_chain(int depth) {
+        if (depth == 0) {
+            co_return 0;
+        }
+        co_return co_await pooled_chain(depth - 1) + 1;
+    }
+
+    // std::allocator routes every frame to global operator new.
+    cocoro::task<int> global_new_chain(std::allocator_arg_t, const std::allocator<std::byte>& alloc, int depth) {
+        if (depth == 0) {
+            co_return 0;
+        }
+        co_return co_await global_new_chain(std::allocator_arg, alloc, depth - 1) + 1;
+    }
+
+    cocoro::detached_task drive(cocoro::task<int> chain, int& sink) {
+        sink = co_await std::move(chain);
+    }
+
+    // Frames created here and destroyed by a helper thread, as when handlers hand
+    // their tasks to a worker. They come back through the global overflow.
+    void measure_cross_thread() {
+        constexpr std::size_t batch = 512;
+        constexpr std::size_t rounds = 2'000;
+        std::vector<cocoro::task<int>> frames;
+        frames.reserve(batch);
+        std::atomic<bool> full = false;
+        std::atomic<bool> stopping = false;
+        std::jthread helper([&] {
+            while (true) {
+                full.wait(false, std::memory_order_acquire);
+                if (stopping.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                frames.clear();
+                full.store(false, std::memory_order_release);
+                full.notify_one();
+            }
+        });
+        const cocoro::frame_pool_stats before = cocoro::this_thread::snapshot_frame_pool_stats();
+        cocoro::bench::measure_batch("frame pool, freed by another thread", rounds, batch, [&] {
+            for (std::size_t i = 0; i < batch; ++i) {
+                frames.push_back(pooled_chain(0));
+            }
+            full.store(true, std::memory_order_release);
+            full.notify_one();
+            full.wait(true, std::memory_order_acquire);
+        });
+        const cocoro::frame_pool_stats after = cocoro::this_thread::snapshot_frame_pool_stats();
+        const cocoro::frame_pool_stats delta{
+            .hits = after.hits - before.hits,
+            .misses = after.misses - before.misses,
+        };
+        std::println("{:<48} {:>12.3f}", "  hit rate of the allocating thread", delta.hit_rate());
+        stopping.store(true, std::memory_order_relaxed);
+        full.store(true, std::memory_order_release);
+        full.notify_one();
+    }
+
+    void run() {
+        using cocoro::bench::measure;
+        for (const int depth : { 1, 8, 64, 512 }) {
+            const std::size_t iterations = 1'000'000 / depth;
+            int sink = 0;
+            measure(std::format("frame pool, depth {}", depth), iterations, [&] {
+                drive(pooled_chain(depth), sink).start();
+            });
+            measure(std::format("global new, depth {}", depth), iterations, [&] {
+                drive(global_new_chain(std::allocator_arg, {}, depth), sink).start();
+            });
+            cocoro::bench::do_not_optimize(sink);
+        }
+        measure_cross_thread();
+    }
+
+    const cocoro::bench::registrar registered("frame_alloc", &run);
+
+} // namespace
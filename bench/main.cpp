@@ -0,0 +1,26 @@
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <new>
+
+void* operator new(std::size_t size) {
+    cocoro::bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// usage: bench [filter], runs benchmarks whose name contains filter
+int main(int argc, char** argv) {
+    const std::string_view filter = argc > 1 ? argv[1] : "";
+    for (const auto& [name, run] : cocoro::bench::registry()) {
+        if (name.contains(filter)) {
+            std::println("[{}]", name);
+            run();
+        }
+    }
+}
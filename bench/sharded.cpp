@@ -0,0 +1,79 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <format>
+#include <vector>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/sharded_runtime.hpp"
+#include "cocoro/task.hpp"
+#include "cocoro/when_all.hpp"
+
+// Round trips of co_await on_shard() between two pinned shards.
+namespace {
+
+    constexpr std::size_t round_trips = 200'000;
+
+    cocoro::task<std::size_t> echo(std::size_t value) {
+        co_return value;
+    }
+
+    // Awaits one call after another, so each one is a full round trip.
+    cocoro::detached_task ping(cocoro::sharded_runtime& runtime, std::size_t target, std::atomic<bool>& done) {
+        co_await runtime.schedule(0);
+        std::size_t sink = 0;
+        for (std::size_t i = 0; i < round_trips; ++i) {
+            sink += co_await cocoro::on_shard(target, echo(i));
+        }
+        cocoro::bench::do_not_optimize(sink);
+        done.store(true, std::memory_order_release);
+        done.notify_one();
+    }
+
+    // Keeps `in_flight` calls outstanding, the rings carry batches then.
+    cocoro::detached_task ping_many(cocoro::sharded_runtime& runtime, std::size_t in_flight, std::atomic<bool>& done) {
+        co_await runtime.schedule(0);
+        std::size_t sink = 0;
+        for (std::size_t sent = 0; sent < round_trips; sent += in_flight) {
+            std::vector<cocoro::task<std::size_t>> calls;
+            calls.reserve(in_flight);
+            for (std::size_t i = 0; i < in_flight; ++i) {
+                calls.push_back(cocoro::on_shard(1, echo(i)));
+            }
+            for (const std::size_t value : co_await cocoro::when_all(std::move(calls))) {
+                sink += value;
+            }
+        }
+        cocoro::bench::do_not_optimize(sink);
+        done.store(true, std::memory_order_release);
+        done.notify_one();
+    }
+
+    void wait(std::atomic<bool>& done) {
+        done.wait(false, std::memory_order_acquire);
+        done.store(false, std::memory_order_relaxed);
+    }
+
+    void run() {
+        cocoro::sharded_runtime runtime(2);
+        std::atomic<bool> done = false;
+        cocoro::bench::measure_once("on_shard round trip, same shard", round_trips, [&] {
+            ping(runtime, 0, done).start();
+            wait(done);
+        });
+        cocoro::bench::measure_once("on_shard round trip, cross shard", round_trips, [&] {
+            ping(runtime, 1, done).start();
+            wait(done);
+        });
+        for (const std::size_t in_flight : { 16, 128 }) {
+            cocoro::bench::measure_once(std::format("on_shard cross shard, {} in flight", in_flight), round_trips, [&] {
+                ping_many(runtime, in_flight, done).start();
+                wait(done);
+            });
+        }
+    }
+
+    const cocoro::bench::registrar registered("sharded", &run);
+
+} // namespace
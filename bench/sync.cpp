@@ -0,0 +1,131 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <format>
+#include <mutex>
+
+#include "cocoro/async_latch.hpp"
+#include "cocoro/async_mutex.hpp"
+#include "cocoro/async_semaphore.hpp"
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+#include "cocoro/thread_pool.hpp"
+
+namespace {
+
+    constexpr std::size_t lock_count = 1'000'000;
+    constexpr std::size_t latch_rounds = 100'000;
+
+    // Contenders left to finish. Outlives the pool, the last contender may still be
+    // notifying after the waiter returned.
+    constinit std::atomic<std::size_t> remaining = 0;
+
+    struct shared_state {
+        std::size_t counter = 0;
+        std::atomic<std::size_t> entered = 0; // for sections more than one contender may enter
+    };
+
+    void finish() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            remaining.notify_one();
+        }
+    }
+
+    void wait_all() {
+        for (std::size_t left = remaining.load(); left != 0; left = remaining.load()) {
+            remaining.wait(left);
+        }
+    }
+
+    cocoro::detached_task async_contender(cocoro::thread_pool& pool, cocoro::async_mutex& mutex,
+        std::size_t locks, shared_state& state) {
+        co_await pool.schedule();
+        for (std::size_t i = 0; i < locks; ++i) {
+            const auto lock = co_await mutex.lock();
+            ++state.counter;
+        }
+        finish();
+    }
+
+    cocoro::detached_task semaphore_contender(cocoro::thread_pool& pool, cocoro::async_semaphore& semaphore,
+        std::size_t locks, shared_state& state) {
+        co_await pool.schedule();
+        for (std::size_t i = 0; i < locks; ++i) {
+            co_await semaphore.acquire();
+            state.entered.fetch_add(1, std::memory_order_relaxed);
+            semaphore.release();
+        }
+        finish();
+    }
+
+    cocoro::detached_task blocking_contender(cocoro::thread_pool& pool, std::mutex& mutex,
+        std::size_t locks, shared_state& state) {
+        co_await pool.schedule();
+        for (std::size_t i = 0; i < locks; ++i) {
+            const std::scoped_lock lock(mutex);
+            ++state.counter;
+        }
+        finish();
+    }
+
+    // Every contender counts down each latch in turn and waits for the others to do so.
+    cocoro::detached_task latch_contender(cocoro::thread_pool& pool, std::deque<cocoro::async_latch>& latches) {
+        co_await pool.schedule();
+        for (cocoro::async_latch& latch : latches) {
+            latch.count_down();
+            co_await latch.wait();
+        }
+        finish();
+    }
+
+    template<typename Sync, typename Contender>
+    void measure_contention(std::string_view name, cocoro::thread_pool& pool, std::size_t contenders,
+        Sync& sync, Contender contender) {
+        shared_state state;
+        cocoro::bench::measure_once(std::format("{}, {} coroutine(s), {} workers", name, contenders, pool.size()),
+            lock_count, [&] {
+                remaining.store(contenders);
+                for (std::size_t i = 0; i < contenders; ++i) {
+                    contender(pool, sync, lock_count / contenders + (i < lock_count % contenders), state).start();
+                }
+                wait_all();
+            });
+        cocoro::bench::do_not_optimize(state.counter);
+    }
+
+    // No std::latch counterpart: blocking waits would deadlock with more contenders than workers.
+    void measure_latch(cocoro::thread_pool& pool, std::size_t contenders) {
+        std::deque<cocoro::async_latch> latches;
+        for (std::size_t i = 0; i < latch_rounds; ++i) {
+            latches.emplace_back(contenders);
+        }
+        cocoro::bench::measure_once(std::format("async_latch, {} coroutine(s), {} workers", contenders, pool.size()),
+            latch_rounds * contenders, [&] {
+                remaining.store(contenders);
+                for (std::size_t i = 0; i < contenders; ++i) {
+                    latch_contender(pool, latches).start();
+                }
+                wait_all();
+            });
+    }
+
+    void run() {
+        cocoro::thread_pool pool;
+        for (const std::size_t contenders : { 1, 4, 32 }) {
+            cocoro::async_mutex async_mutex;
+            measure_contention("async_mutex", pool, contenders, async_mutex, &async_contender);
+            cocoro::async_semaphore binary_semaphore(1);
+            measure_contention("async_semaphore(1)", pool, contenders, binary_semaphore, &semaphore_contender);
+            cocoro::async_semaphore counting_semaphore(4);
+            measure_contention("async_semaphore(4)", pool, contenders, counting_semaphore, &semaphore_contender);
+            std::mutex mutex;
+            measure_contention("std::mutex", pool, contenders, mutex, &blocking_contender);
+            measure_latch(pool, contenders);
+        }
+    }
+
+    const cocoro::bench::registrar registered("sync", &run);
+
+} // namespace
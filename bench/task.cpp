@@ -0,0 +1,127 @@
+#include "bench.hpp"
+
+#include <array>
+#include <cstddef>
+#include <format>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+
+// Single threaded costs of the task machinery, no scheduler involved.
+namespace {
+
+    constexpr std::size_t operations = 1'000'000;
+
+    cocoro::task<int> leaf() {
+        co_return 1;
+    }
+
+    cocoro::task<int> chain(int depth) {
+        if (depth == 0) {
+            co_return 0;
+        }
+        co_return co_await chain(depth - 1) + 1;
+    }
+
+    template<typename T>
+    cocoro::detached_task drive(cocoro::task<T> work, T& sink) {
+        sink = co_await std::move(work);
+    }
+
+    void measure_create_destroy() {
+        cocoro::bench::measure("task create and destroy, never started", operations, [] {
+            cocoro::task<int> task = leaf();
+            cocoro::bench::do_not_optimize(task);
+        });
+        int sink = 0;
+        cocoro::bench::measure("task create, await and destroy", operations, [&] {
+            drive(leaf(), sink).start();
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    void measure_chains() {
+        for (const int depth : { 1, 4, 16, 64, 256, 1024 }) {
+            int sink = 0;
+            cocoro::bench::measure_batch(std::format("frame in co_await chain of depth {}", depth),
+                operations / depth, depth, [&] {
+                    drive(chain(depth), sink).start();
+                });
+            cocoro::bench::do_not_optimize(sink);
+        }
+    }
+
+    struct large_result {
+        std::array<std::size_t, 32> words = {};
+    };
+
+    template<typename T>
+    std::size_t touch(const T& value) noexcept {
+        if constexpr (std::same_as<T, large_result>) {
+            return value.words[0];
+        } else if constexpr (std::same_as<T, std::string>) {
+            return value.size();
+        } else {
+            return static_cast<std::size_t>(value);
+        }
+    }
+
+    // Result slots of task<T> are symmetric_result<T>.
+    template<typename T>
+    cocoro::task<T> produce(std::remove_reference_t<T>& source) {
+        co_return source;
+    }
+
+    template<typename T>
+    cocoro::task<std::size_t> consume_loop(std::remove_reference_t<T>& source) {
+        std::size_t sink = 0;
+        for (std::size_t i = 0; i < operations; ++i) {
+            decltype(auto) value = co_await produce<T>(source);
+            sink += touch(value);
+        }
+        co_return sink;
+    }
+
+    template<typename T>
+    void measure_result(std::string_view name, std::remove_reference_t<T> source) {
+        std::size_t sink = 0;
+        cocoro::bench::measure_once(std::format("await task<{}>", name), operations, [&] {
+            drive(consume_loop<T>(source), sink).start();
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    void measure_results() {
+        measure_result<int>("int", 1);
+        measure_result<int&>("int&", 1);
+        measure_result<large_result>(std::format("{} byte struct", sizeof(large_result)), {});
+        measure_result<std::string>("std::string (heap)", std::string(64, 'x'));
+    }
+
+    cocoro::detached_task spawn_inline(std::size_t& sink) {
+        ++sink;
+        co_return;
+    }
+
+    void measure_detached_spawn() {
+        std::size_t sink = 0;
+        cocoro::bench::measure("detached_task spawn, runs inline to completion", operations, [&] {
+            spawn_inline(sink).start();
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    void run() {
+        measure_create_destroy();
+        measure_chains();
+        measure_results();
+        measure_detached_spawn();
+    }
+
+    const cocoro::bench::registrar registered("task", &run);
+
+} // namespace
@@ -0,0 +1,92 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <format>
+#include <vector>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+#include "cocoro/thread_pool.hpp"
+
+namespace {
+
+    // Tasks left to run. Outlives the pool, the last task may still be notifying
+    // after the waiter returned.
+    constinit std::atomic<std::size_t> remaining = 0;
+
+    cocoro::task<void> tiny() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            remaining.notify_one();
+        }
+        co_return;
+    }
+
+    cocoro::detached_task spawn_one(cocoro::thread_pool& pool) {
+        co_await pool.schedule();
+        co_await tiny();
+    }
+
+    // Spawns from a worker, so that tasks land in LIFO slots and deques and get stolen.
+    cocoro::detached_task spawner(cocoro::thread_pool& pool, std::size_t count) {
+        co_await pool.schedule();
+        for (std::size_t i = 0; i < count; ++i) {
+            spawn_one(pool).start();
+        }
+    }
+
+    cocoro::detached_task finish_one() {
+        co_await tiny();
+    }
+
+    void wait_all() {
+        for (std::size_t left = remaining.load(); left != 0; left = remaining.load()) {
+            remaining.wait(left);
+        }
+    }
+
+    // Dispatch from outside the pool, through the injection queue.
+    void measure_external(cocoro::thread_pool& pool, std::size_t task_count) {
+        cocoro::bench::measure_once("external start, one post per task", task_count, [&] {
+            remaining.store(task_count);
+            for (std::size_t i = 0; i < task_count; ++i) {
+                spawn_one(pool).start();
+            }
+            wait_all();
+        });
+        std::vector<cocoro::detached_task> tasks;
+        for (const std::size_t batch : { 16, 256 }) {
+            cocoro::bench::measure_once(std::format("external spawn_batch, batches of {}", batch), task_count, [&] {
+                remaining.store(task_count);
+                for (std::size_t spawned = 0; spawned < task_count; spawned += tasks.size()) {
+                    tasks.clear();
+                    for (std::size_t i = 0; i < batch && spawned + i < task_count; ++i) {
+                        tasks.push_back(finish_one());
+                    }
+                    cocoro::spawn_batch(pool, tasks);
+                }
+                wait_all();
+            });
+        }
+    }
+
+    void run() {
+        constexpr std::size_t task_count = 4'000'000;
+        cocoro::thread_pool pool;
+
+        for (const std::size_t spawners : { std::size_t{ 1 }, pool.size() }) {
+            cocoro::bench::measure_once(std::format("spawn tiny tasks, {} spawner(s), {} workers", spawners, pool.size()),
+                task_count, [&] {
+                    remaining.store(task_count);
+                    for (std::size_t i = 0; i < spawners; ++i) {
+                        spawner(pool, task_count / spawners + (i < task_count % spawners)).start();
+                    }
+                    wait_all();
+                });
+        }
+
+        measure_external(pool, task_count / 4);
+    }
+
+    const cocoro::bench::registrar registered("thread_pool", &run);
+
+} // namespace
@@ -0,0 +1,62 @@
+#include "bench.hpp"
+
+#include <cstddef>
+#include <format>
+#include <string_view>
+
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+
+// Compare builds with `xmake f --trace=y` and `xmake f --trace=n`, on both targets.
+namespace {
+
+#ifdef COCORO_DISABLE_TRACE
+    constexpr std::string_view mode = "trace off";
+#else
+    constexpr std::string_view mode = "trace on";
+#endif
+
+    constexpr std::size_t awaits = 10'000'000;
+
+    // Each await of a ready awaitable only pays for the await_transform.
+    cocoro::task<std::size_t> await_ready_loop() {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < awaits; ++i) {
+            co_await std::suspend_never{};
+            ++count;
+        }
+        co_return count;
+    }
+
+    cocoro::task<int> chain(int depth) {
+        if (depth == 0) {
+            co_return 0;
+        }
+        co_return co_await chain(depth - 1) + 1;
+    }
+
+    template<typename T>
+    cocoro::detached_task drive(cocoro::task<T> work, T& sink) {
+        sink = co_await std::move(work);
+    }
+
+    void run() {
+        std::println("{}: sizeof(task<int>::promise_type) = {}", mode, sizeof(cocoro::task<int>::promise_type));
+
+        std::size_t count = 0;
+        cocoro::bench::measure_once(std::format("{}, await ready awaitable", mode), awaits, [&] {
+            drive(await_ready_loop(), count).start();
+        });
+        cocoro::bench::do_not_optimize(count);
+
+        constexpr int depth = 64;
+        int sink = 0;
+        cocoro::bench::measure_batch(std::format("{}, frame in chain of depth {}", mode, depth), 1'000'000 / depth, depth, [&] {
+            drive(chain(depth), sink).start();
+        });
+        cocoro::bench::do_not_optimize(sink);
+    }
+
+    const cocoro::bench::registrar registered("trace", &run);
+
+} // namespace
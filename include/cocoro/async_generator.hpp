@@ -0,0 +1,167 @@
+#pragma once
+#ifndef COCORO_ASYNC_GENERATOR_H
+#define COCORO_ASYNC_GENERATOR_H 1
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/basic_promise.hpp"
+#include "cocoro/utils/frame_alloc.hpp"
+#include "cocoro/env/trace.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
+
+namespace cocoro {
+
+    // Lazy asynchronous sequence, the body may both co_await and co_yield.
+    // Consumers drive it with
+    //
+    //   for (auto it = co_await gen.begin(); it != gen.end(); co_await ++it) { use(*it); }
+    //
+    // Every handoff in either direction is a symmetric transfer, and the generator
+    // inherits the env of the coroutine awaiting begin() or ++ each time it is resumed.
+    // Yielded objects are referenced, not copied, and stay alive until the next increment.
+    template<typename T>
+    class [[nodiscard]] async_generator
+    {
+    public:
+        struct promise_type;
+        using handle_type = std::coroutine_handle<promise_type>;
+        using value_type = std::remove_cvref_t<T>;
+        using reference = std::conditional_t<std::is_reference_v<T>, T, T&>;
+        using pointer = std::add_pointer_t<reference>;
+
+        struct promise_type :
+            public basic_promise_base<env::default_trace_env, env::affine_env, env::stop_token_env>,
+            public env::default_trace_await_base,
+            public frame_allocator_base
+        {
+            async_generator get_return_object() noexcept {
+                return async_generator(handle_type::from_promise(*this));
+            }
+
+            void set_suspension_point_info(std::source_location&& loc) noexcept {
+                get_mut_env().set_suspension_point_info(std::move(loc));
+            }
+
+            // back to the consumer, on its scheduler
+            affine_final_awaiter yield_value(std::remove_reference_t<reference>& value) noexcept {
+                current = std::addressof(value);
+                return {};
+            }
+
+            // the temporary lives until the generator is resumed
+            affine_final_awaiter yield_value(std::remove_reference_t<reference>&& value) noexcept
+                requires (!std::is_lvalue_reference_v<T>) {
+                current = std::addressof(value);
+                return {};
+            }
+
+            void return_void() noexcept { current = nullptr; }
+
+            void unhandled_exception() noexcept {
+                current = nullptr;
+                exception = std::current_exception();
+            }
+
+            pointer current = nullptr;
+            std::exception_ptr exception = nullptr;
+        };
+
+        class iterator
+        {
+        public:
+            using value_type = async_generator::value_type;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() = default;
+
+            reference operator*() const noexcept { return static_cast<reference>(*handle.promise().current); }
+
+            pointer operator->() const noexcept { return handle.promise().current; }
+
+            // co_await the result to advance
+            [[nodiscard]] auto operator++() noexcept { return advance_awaiter(handle); }
+
+            friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept {
+                return it.handle == nullptr || it.handle.done();
+            }
+
+        private:
+            friend async_generator;
+            friend class advance_awaiter;
+            explicit iterator(handle_type handle) noexcept : handle(handle) {}
+
+            handle_type handle = nullptr;
+        };
+
+        class [[nodiscard]] advance_awaiter
+        {
+        public:
+            constexpr bool await_ready() const noexcept { return false; }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> consumer) noexcept {
+                handle.promise().set_continuation(consumer);
+                details::trace_enter(details::trace_entry_of(handle.promise())); // resumed past a yield
+                return handle;
+            }
+
+            iterator await_resume() const {
+                promise_type& promise = handle.promise();
+                if (promise.exception != nullptr) {
+                    std::rethrow_exception(std::exchange(promise.exception, nullptr));
+                }
+                return iterator(handle);
+            }
+
+        private:
+            friend async_generator;
+            friend iterator;
+            explicit advance_awaiter(handle_type handle) noexcept : handle(handle) {}
+
+            handle_type handle;
+        };
+
+        async_generator(const async_generator&) = delete;
+        async_generator& operator=(const async_generator&) = delete;
+
+        async_generator(async_generator&& other) noexcept :
+            handle(std::exchange(other.handle, nullptr))
+        {}
+
+        async_generator& operator=(async_generator&& other) noexcept {
+            auto(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        ~async_generator() {
+            if (handle != nullptr) {
+                handle.destroy();
+            }
+        }
+
+        void swap(async_generator& other) noexcept {
+            std::ranges::swap(handle, other.handle);
+        }
+
+        // co_await the result to start the generator and get an iterator to the first element.
+        // Can only be awaited once.
+        advance_awaiter begin() noexcept { return advance_awaiter(handle); }
+
+        std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+    private:
+        explicit async_generator(handle_type handle) noexcept : handle(handle) {}
+
+        handle_type handle = nullptr;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_ASYNC_GENERATOR_H
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef COCORO_ASYNC_LATCH_H
+#define COCORO_ASYNC_LATCH_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/waiter.hpp"
+
+namespace cocoro {
+
+    // Single use countdown, wait() suspends the awaiting coroutine until it reaches zero.
+    // Waiters form a LIFO stack in one atomic word, which turns into a sentinel once released;
+    // released waiters resume on the scheduler of their env.
+    class async_latch : private details::pinned
+    {
+    public:
+        class [[nodiscard]] wait_awaiter : private details::waiter_node
+        {
+        public:
+            // fast path once released
+            bool await_ready() const noexcept { return latch.try_wait(); }
+
+            template<typename Promise>
+            bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                prepare(handle);
+                std::uintptr_t state = latch.waiters.load(std::memory_order_acquire);
+                do {
+                    if (state == released) {
+                        return false;
+                    }
+                    next = reinterpret_cast<waiter_node*>(state);
+                } while (!latch.waiters.compare_exchange_weak(state, reinterpret_cast<std::uintptr_t>(this),
+                    std::memory_order_release, std::memory_order_acquire));
+                return true;
+            }
+
+            constexpr void await_resume() const noexcept {}
+
+        private:
+            friend async_latch;
+            explicit wait_awaiter(async_latch& latch) noexcept : latch(latch) {}
+
+            async_latch& latch;
+        };
+
+        explicit async_latch(std::size_t expected) noexcept :
+            remaining(expected),
+            waiters(expected == 0 ? released : 0)
+        {}
+
+        // The last count down releases every waiter.
+        void count_down(std::size_t n = 1) noexcept {
+            if (remaining.fetch_sub(n, std::memory_order_acq_rel) == n) {
+                const std::uintptr_t stack = waiters.exchange(released, std::memory_order_acq_rel);
+                details::wake_all(reinterpret_cast<details::waiter_node*>(stack));
+            }
+        }
+
+        bool try_wait() const noexcept { return waiters.load(std::memory_order_acquire) == released; }
+
+        // co_await the result of this function to wait for the latch to be released
+        wait_awaiter wait() noexcept { return wait_awaiter(*this); }
+
+    private:
+        // never a node address, nodes are at least 2 aligned
+        static constexpr std::uintptr_t released = 1;
+
+        std::atomic<std::size_t> remaining;
+        std::atomic<std::uintptr_t> waiters;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_ASYNC_LATCH_H
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef COCORO_ASYNC_MUTEX_H
+#define COCORO_ASYNC_MUTEX_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/waiter.hpp"
+
+namespace cocoro {
+
+    class async_mutex;
+
+    // Owns a locked async_mutex, unlocks on destruction.
+    class [[nodiscard]] async_mutex_lock
+    {
+    public:
+        async_mutex_lock(const async_mutex_lock&) = delete;
+        async_mutex_lock& operator=(const async_mutex_lock&) = delete;
+
+        async_mutex_lock(async_mutex_lock&& other) noexcept :
+            mutex(std::exchange(other.mutex, nullptr))
+        {}
+
+        async_mutex_lock& operator=(async_mutex_lock&& other) noexcept {
+            auto(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        ~async_mutex_lock();
+
+        void swap(async_mutex_lock& other) noexcept {
+            std::ranges::swap(mutex, other.mutex);
+        }
+
+    private:
+        friend async_mutex;
+        explicit async_mutex_lock(async_mutex& mutex) noexcept : mutex(&mutex) {}
+
+        async_mutex* mutex = nullptr;
+    };
+
+    // Mutex whose lock() suspends the awaiting coroutine instead of blocking its thread.
+    // The whole state is one atomic word: unlocked, locked, or locked with a LIFO stack of
+    // newly arrived waiters. The holder moves them to a private FIFO queue on unlock,
+    // so ownership is handed over in arrival order, and the next owner is resumed
+    // on the scheduler of its env. Waiters on the inline scheduler are resumed in a loop
+    // by the outermost unlock of the thread rather than inside nested unlocks.
+    class async_mutex : private details::pinned
+    {
+    public:
+        class [[nodiscard]] lock_awaiter : private details::waiter_node
+        {
+        public:
+            // uncontended fast path
+            bool await_ready() noexcept { return mutex.try_lock(); }
+
+            template<typename Promise>
+            bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                prepare(handle);
+                std::uintptr_t state = mutex.state.load(std::memory_order_acquire);
+                while (true) {
+                    if (state == not_locked) {
+                        if (mutex.state.compare_exchange_weak(state, locked_no_waiters,
+                            std::memory_order_acquire, std::memory_order_relaxed)) {
+                            return false; // acquired after all
+                        }
+                    } else {
+                        next = reinterpret_cast<waiter_node*>(state);
+                        if (mutex.state.compare_exchange_weak(state, reinterpret_cast<std::uintptr_t>(this),
+                            std::memory_order_release, std::memory_order_relaxed)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            async_mutex_lock await_resume() const noexcept { return async_mutex_lock(mutex); }
+
+        private:
+            friend async_mutex;
+            explicit lock_awaiter(async_mutex& mutex) noexcept : mutex(mutex) {}
+
+            async_mutex& mutex;
+        };
+
+        async_mutex() = default;
+
+        // co_await the result of this function to get an async_mutex_lock
+        lock_awaiter lock() noexcept { return lock_awaiter(*this); }
+
+        bool try_lock() noexcept {
+            std::uintptr_t expected = not_locked;
+            return state.compare_exchange_strong(expected, locked_no_waiters,
+                std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        void unlock() noexcept {
+            details::waiter_node* head = waiters;
+            if (head == nullptr) {
+                std::uintptr_t expected = locked_no_waiters;
+                if (state.compare_exchange_strong(expected, not_locked,
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                    return;
+                }
+                // take the newcomers and reverse them into arrival order
+                std::uintptr_t stack = state.exchange(locked_no_waiters, std::memory_order_acquire);
+                auto* node = reinterpret_cast<details::waiter_node*>(stack);
+                while (node != nullptr) {
+                    details::waiter_node* next = node->next;
+                    node->next = head;
+                    head = node;
+                    node = next;
+                }
+            }
+            waiters = head->next;
+            head->wake(); // ownership passes to the woken coroutine
+        }
+
+    private:
+        // any other value is the top of the stack of new waiters, with the mutex locked
+        static constexpr std::uintptr_t locked_no_waiters = 0;
+        static constexpr std::uintptr_t not_locked = 1;
+
+        std::atomic<std::uintptr_t> state = not_locked;
+        details::waiter_node* waiters = nullptr; // owned by the holder
+    };
+
+    inline async_mutex_lock::~async_mutex_lock() {
+        if (mutex != nullptr) {
+            mutex->unlock();
+        }
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_ASYNC_MUTEX_H
@@ -0,0 +1,189 @@
+#pragma once
+#ifndef COCORO_ASYNC_SCOPE_H
+#define COCORO_ASYNC_SCOPE_H 1
+
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <stop_token>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
+#include "cocoro/detached_task.hpp"
+#include "cocoro/task.hpp"
+
+namespace cocoro {
+
+    // Owner of detached work: spawned tasks run on their own, and join() waits for
+    // every one of them. Outstanding children are counted in one atomic word, which holds
+    // an extra count for the scope itself until join() gives it up.
+    // A spawned task is adopted as is: its frame completes into the scope, which destroys it,
+    // so a child costs no frame besides its own.
+    // Children observe the stop token of the scope, request_stop() stops them all,
+    // and so does a stop request to the coroutine awaiting join().
+    // A child that exits with an exception does not bring anything down; join() rethrows
+    // the exception of the first child to fail once all are done and drops the others.
+    // spawn() may be called from children at any time, from elsewhere only while nobody joins.
+    // The scope must not be destroyed with children outstanding.
+    class async_scope : private details::pinned, private details::completion_slot
+    {
+    public:
+        class [[nodiscard]] join_awaiter : private details::pinned
+        {
+        public:
+            // fast path when nothing is outstanding
+            bool await_ready() const noexcept {
+                return scope.outstanding.load(std::memory_order_acquire) == 1;
+            }
+
+            template<typename Promise>
+            bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                scope.joiner = handle;
+                scope.joiner_home = details::home_scheduler(handle);
+                if constexpr (env::env_aware<Promise>) {
+                    on_stop.emplace(env::get_stop_token(handle.promise().get_env()), forward_stop{ &scope.source });
+                }
+                if (scope.outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    scope.rearm();
+                    return false;
+                }
+                return true;
+            }
+
+            void await_resume() {
+                on_stop.reset();
+                scope.collect();
+            }
+
+        private:
+            friend async_scope;
+            explicit join_awaiter(async_scope& scope) noexcept : scope(scope) {}
+
+            struct forward_stop {
+                std::inplace_stop_source* source;
+                void operator()() const noexcept { source->request_stop(); }
+            };
+
+            async_scope& scope;
+            std::optional<std::inplace_stop_callback<forward_stop>> on_stop;
+        };
+
+        async_scope() noexcept : completion_slot{ &async_scope::complete_child, true } {}
+
+        ~async_scope() {
+            if (outstanding.load(std::memory_order_acquire) != 1) {
+                std::terminate(); // children still refer to this scope
+            }
+        }
+
+        // Runs `work` on the calling thread until its first suspension.
+        template<typename T>
+        void spawn(task<T> work) {
+            adopt(std::move(work), nullptr).resume();
+        }
+
+        // Hands `work` over to `sched` to start it, `work` completes on `sched`.
+        // Takes schedulers that answer get_scheduler with a reference of their own,
+        // such as thread_pool, run_loop and io_uring_context.
+        template<typename Sched, typename T>
+            requires scheduler<Sched> && requires (const Sched& sched) {
+                { sched.query(env::get_scheduler) } noexcept -> std::same_as<const scheduler_ref&>;
+            }
+        void spawn(Sched& sched, task<T> work) {
+            spawn(sched.query(env::get_scheduler), std::move(work));
+        }
+
+        // Same, with `sched` referenced, not copied, as by scheduler_scope.
+        template<typename T>
+        void spawn(const scheduler_ref& sched, task<T> work) {
+            sched.post(adopt(std::move(work), &sched));
+        }
+
+        template<typename T>
+        void spawn(scheduler_ref&&, task<T>) = delete;
+
+        // co_await the result of this function to wait for every child, including
+        // those spawned meanwhile, then rethrow the exception of the first one to fail
+        join_awaiter join() noexcept { return join_awaiter(*this); }
+
+        void request_stop() noexcept { source.request_stop(); }
+
+        // Token observed by children, it stays stopped once stop is requested.
+        std::inplace_stop_token get_stop_token() const noexcept { return source.get_token(); }
+
+    private:
+        template<typename T>
+        std::coroutine_handle<> adopt(task<T>&& work, const scheduler_ref* home) noexcept {
+            const auto handle = std::exchange(work.handle, nullptr);
+            auto& promise = handle.promise();
+            promise.set_completion_slot(*this);
+            promise.get_mut_env().set_stop_token(source.get_token());
+            if (home != nullptr) {
+                promise.get_mut_env().set_scheduler(*home);
+            }
+            outstanding.fetch_add(1, std::memory_order_relaxed);
+            return handle;
+        }
+
+        // Called by a child done running, in place of its continuation.
+        static std::coroutine_handle<> complete_child(completion_slot& slot, std::coroutine_handle<> frame,
+            const std::exception_ptr* error, bool stopped) noexcept {
+            async_scope& self = static_cast<async_scope&>(slot);
+            if (stopped) {
+                // the awaiter that stopped the child is still running in its frame
+                return release_stopped(frame, self).to_handle();
+            }
+            if (error != nullptr && !self.failed.exchange(true, std::memory_order_relaxed)) {
+                self.first_error = *error;
+            }
+            frame.destroy();
+            return self.leave();
+        }
+
+        static detached_task release_stopped(std::coroutine_handle<> frame, async_scope& self) {
+            frame.destroy();
+            self.leave().resume();
+            co_return;
+        }
+
+        // Gives up the count of a child, the last one out while joining resumes the joiner.
+        std::coroutine_handle<> leave() noexcept {
+            if (outstanding.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return std::noop_coroutine();
+            }
+            // last one out while joining
+            const std::coroutine_handle<> cont = std::exchange(joiner, nullptr);
+            const scheduler_ref home = joiner_home;
+            rearm();
+            return details::continue_on(home, cont);
+        }
+
+        // The scope takes its own count back for the next join.
+        void rearm() noexcept {
+            outstanding.store(1, std::memory_order_relaxed);
+        }
+
+        // Rethrows the exception of the first child to fail since the last join.
+        void collect() {
+            if (failed.load(std::memory_order_relaxed)) {
+                failed.store(false, std::memory_order_relaxed);
+                std::rethrow_exception(std::exchange(first_error, nullptr));
+            }
+        }
+
+        std::atomic<std::size_t> outstanding = 1;
+        std::atomic<bool> failed = false;
+        std::exception_ptr first_error = nullptr; // written once per join, by whoever sets `failed`
+        std::coroutine_handle<> joiner = nullptr;
+        scheduler_ref joiner_home = {};
+        std::inplace_stop_source source;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_ASYNC_SCOPE_H
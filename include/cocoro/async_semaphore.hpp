@@ -0,0 +1,142 @@
+#pragma once
+#ifndef COCORO_ASYNC_SEMAPHORE_H
+#define COCORO_ASYNC_SEMAPHORE_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/waiter.hpp"
+
+namespace cocoro {
+
+    // Counting semaphore whose acquire() suspends the awaiting coroutine while no permit is left.
+    // The state is one atomic word, holding either the number of permits (tagged by the low bit)
+    // or the top of a LIFO stack of waiters when none is left.
+    // Releasers take the whole stack at once, so waiters are never popped one by one
+    // and there is no ABA hazard; woken waiters resume on the scheduler of their env.
+    class async_semaphore : private details::pinned
+    {
+    public:
+        class [[nodiscard]] acquire_awaiter : private details::waiter_node
+        {
+        public:
+            // uncontended fast path
+            bool await_ready() noexcept { return sem.try_acquire(); }
+
+            template<typename Promise>
+            bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                prepare(handle);
+                std::uintptr_t state = sem.state.load(std::memory_order_acquire);
+                while (true) {
+                    if (is_count(state) && count_of(state) != 0) {
+                        if (sem.state.compare_exchange_weak(state, state - count_one,
+                            std::memory_order_acquire, std::memory_order_relaxed)) {
+                            return false; // got a permit after all
+                        }
+                    } else {
+                        next = is_count(state) ? nullptr : reinterpret_cast<waiter_node*>(state);
+                        if (sem.state.compare_exchange_weak(state, reinterpret_cast<std::uintptr_t>(this),
+                            std::memory_order_release, std::memory_order_relaxed)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            constexpr void await_resume() const noexcept {}
+
+        private:
+            friend async_semaphore;
+            explicit acquire_awaiter(async_semaphore& sem) noexcept : sem(sem) {}
+
+            async_semaphore& sem;
+        };
+
+        explicit async_semaphore(std::size_t permits) noexcept : state(make_count(permits)) {}
+
+        // co_await the result of this function to take a permit
+        acquire_awaiter acquire() noexcept { return acquire_awaiter(*this); }
+
+        bool try_acquire() noexcept {
+            std::uintptr_t state = this->state.load(std::memory_order_relaxed);
+            while (is_count(state) && count_of(state) != 0) {
+                if (this->state.compare_exchange_weak(state, state - count_one,
+                    std::memory_order_acquire, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void release(std::size_t permits = 1) noexcept {
+            details::waiter_node* owned = nullptr; // waiters taken off the state
+            std::uintptr_t state = this->state.load(std::memory_order_acquire);
+            while (true) {
+                if (owned == nullptr) {
+                    if (permits == 0) {
+                        return;
+                    }
+                    if (is_count(state)) {
+                        if (this->state.compare_exchange_weak(state, state + permits * count_one,
+                            std::memory_order_release, std::memory_order_relaxed)) {
+                            return;
+                        }
+                        continue;
+                    }
+                    if (!this->state.compare_exchange_weak(state, make_count(0),
+                        std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        continue;
+                    }
+                    owned = reinterpret_cast<details::waiter_node*>(state);
+                    state = make_count(0);
+                }
+
+                // hand permits over to owned waiters
+                while (permits != 0 && owned != nullptr) {
+                    details::waiter_node* next = owned->next;
+                    owned->wake();
+                    owned = next;
+                    --permits;
+                }
+                if (owned == nullptr) {
+                    state = this->state.load(std::memory_order_acquire);
+                    continue; // put the remaining permits back
+                }
+
+                // out of permits, grab the ones released meanwhile or give the waiters back
+                if (is_count(state) && count_of(state) != 0) {
+                    if (this->state.compare_exchange_weak(state, make_count(0),
+                        std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        permits = count_of(state);
+                        state = make_count(0);
+                    }
+                    continue;
+                }
+                details::waiter_node* tail = owned;
+                while (tail->next != nullptr) {
+                    tail = tail->next;
+                }
+                tail->next = is_count(state) ? nullptr : reinterpret_cast<details::waiter_node*>(state);
+                if (this->state.compare_exchange_weak(state, reinterpret_cast<std::uintptr_t>(owned),
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                    return;
+                }
+            }
+        }
+
+    private:
+        static constexpr std::uintptr_t count_one = 2;
+
+        static constexpr bool is_count(std::uintptr_t state) noexcept { return (state & 1) != 0; }
+        static constexpr std::size_t count_of(std::uintptr_t state) noexcept { return state >> 1; }
+        static constexpr std::uintptr_t make_count(std::size_t permits) noexcept { return (permits << 1) | 1; }
+
+        std::atomic<std::uintptr_t> state;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_ASYNC_SEMAPHORE_H
@@ -0,0 +1,424 @@
+#pragma once
+#ifndef COCORO_CHANNEL_H
+#define COCORO_CHANNEL_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
+
+namespace cocoro::details {
+
+    // Bounded lock-free MPMC ring, Vyukov style: every cell carries a sequence number
+    // telling whether it is ready for the producer or the consumer of a lap.
+    template<typename T, std::size_t N>
+    class mpmc_ring : private pinned
+    {
+        static_assert(N > 0, "ring capacity must be positive");
+        static_assert(std::is_nothrow_move_constructible_v<T>,
+            "elements are moved into claimed cells, which cannot be given back");
+
+    public:
+        mpmc_ring() noexcept {
+            for (std::size_t index = 0; index < N; ++index) {
+                cells[index].sequence.store(index, std::memory_order_relaxed);
+            }
+        }
+
+        ~mpmc_ring() {
+            std::optional<T> drained;
+            while (try_pop(drained)) {}
+        }
+
+        // Moves from `value` only on success.
+        bool try_push(T& value) noexcept {
+            std::size_t pos = tail.load(std::memory_order_relaxed);
+            while (true) {
+                cell& c = cells[pos % N];
+                const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+                if (diff == 0) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        std::construct_at(c.get(), std::move(value));
+                        c.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false; // full
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool try_pop(std::optional<T>& out) noexcept {
+            std::size_t pos = head.load(std::memory_order_relaxed);
+            while (true) {
+                cell& c = cells[pos % N];
+                const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        out.emplace(std::move(*c.get()));
+                        std::destroy_at(c.get());
+                        c.sequence.store(pos + N, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false; // empty
+                } else {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct cell {
+            std::atomic<std::size_t> sequence;
+            alignas(T) std::byte storage[sizeof(T)];
+
+            T* get() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+        };
+
+        alignas(64) std::atomic<std::size_t> head = 0;
+        alignas(64) std::atomic<std::size_t> tail = 0;
+        alignas(64) cell cells[N];
+    };
+
+    // Intrusive FIFO of suspended channel operations, guarded by the channel mutex.
+    template<typename Node>
+    class waiter_queue
+    {
+    public:
+        bool empty() const noexcept { return first == nullptr; }
+
+        Node* front() const noexcept { return first; }
+
+        void push_back(Node& node) noexcept {
+            node.prev = last;
+            node.next = nullptr;
+            (last != nullptr ? last->next : first) = &node;
+            last = &node;
+            node.queued = true;
+        }
+
+        void remove(Node& node) noexcept {
+            (node.prev != nullptr ? node.prev->next : first) = node.next;
+            (node.next != nullptr ? node.next->prev : last) = node.prev;
+            node.prev = node.next = nullptr;
+            node.queued = false;
+        }
+
+    private:
+        Node* first = nullptr;
+        Node* last = nullptr;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Bounded multi-producer multi-consumer channel of N elements.
+    //
+    //   bool sent = co_await chan.send(value);           // false once closed
+    //   std::optional<T> item = co_await chan.receive(); // nullopt once closed and drained
+    //
+    // Elements go through a lock-free ring; only operations that have to wait take the lock,
+    // where they are queued as intrusive nodes living in their awaiters.
+    // A waiter is resumed through the scheduler in its env once served,
+    // while a stop request through the env stop token unwinds it on the requesting thread.
+    template<typename T, std::size_t N>
+    class channel : private details::pinned
+    {
+        enum class wait_status : unsigned char {
+            waiting, done, closed,
+        };
+
+        // Common part of send and receive awaiters.
+        struct waiter : private details::pinned
+        {
+            waiter* prev = nullptr;
+            waiter* next = nullptr;
+            bool queued = false;
+            wait_status status = wait_status::waiting;
+            std::coroutine_handle<> handle = nullptr;
+            scheduler_ref home = {};
+            stopped_handler_t stopped = &terminate_unhandled_stopped;
+        };
+
+        using waiter_queue = details::waiter_queue<waiter>;
+
+        template<typename Awaiter>
+        struct cancel_fn {
+            Awaiter* self;
+            void operator()() const noexcept { self->chan.cancel(*self); }
+        };
+
+    public:
+        using value_type = T;
+
+        class [[nodiscard]] send_awaiter : private waiter
+        {
+        public:
+            bool await_ready() noexcept {
+                if (chan.is_closed()) {
+                    this->status = wait_status::closed;
+                    return true;
+                }
+                if (chan.ring.try_push(value)) {
+                    chan.serve_receivers();
+                    this->status = wait_status::done;
+                    return true;
+                }
+                return false;
+            }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                return chan.suspend(*this, chan.senders, chan.waiting_senders, handle, [this] {
+                    return chan.ring.try_push(value);
+                });
+            }
+
+            // false if the channel got closed, the value is then dropped
+            bool await_resume() const noexcept { return this->status == wait_status::done; }
+
+        private:
+            friend channel;
+
+            send_awaiter(channel& chan, T&& value) noexcept(std::is_nothrow_move_constructible_v<T>) :
+                chan(chan), value(std::move(value))
+            {}
+
+            channel& chan;
+            T value;
+            std::optional<std::inplace_stop_callback<cancel_fn<send_awaiter>>> on_stop;
+        };
+
+        class [[nodiscard]] receive_awaiter : private waiter
+        {
+        public:
+            bool await_ready() noexcept {
+                if (chan.ring.try_pop(value)) {
+                    chan.serve_senders();
+                    this->status = wait_status::done;
+                    return true;
+                }
+                return false;
+            }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                return chan.suspend(*this, chan.receivers, chan.waiting_receivers, handle, [this] {
+                    return chan.ring.try_pop(value);
+                });
+            }
+
+            // nullopt if the channel is closed and drained
+            std::optional<T> await_resume() noexcept { return std::move(value); }
+
+        private:
+            friend channel;
+
+            explicit receive_awaiter(channel& chan) noexcept : chan(chan) {}
+
+            channel& chan;
+            std::optional<T> value;
+            std::optional<std::inplace_stop_callback<cancel_fn<receive_awaiter>>> on_stop;
+        };
+
+        channel() = default;
+
+        send_awaiter send(T value) noexcept(std::is_nothrow_move_constructible_v<T>) {
+            return send_awaiter(*this, std::move(value));
+        }
+
+        receive_awaiter receive() noexcept { return receive_awaiter(*this); }
+
+        // Fails when the channel is full or closed, `value` is moved from only on success.
+        bool try_send(T& value) noexcept {
+            if (is_closed() || !ring.try_push(value)) {
+                return false;
+            }
+            serve_receivers();
+            return true;
+        }
+
+        std::optional<T> try_receive() noexcept {
+            std::optional<T> value;
+            if (ring.try_pop(value)) {
+                serve_senders();
+            }
+            return value;
+        }
+
+        // Waiting and later sends fail, receivers drain what is left and then get nullopt.
+        void close() noexcept {
+            waiter* woken = nullptr;
+            {
+                std::scoped_lock lock(mutex);
+                closed.store(true, std::memory_order_seq_cst);
+                for (waiter_queue* queue : { &senders, &receivers }) {
+                    while (!queue->empty()) {
+                        waiter& node = *queue->front();
+                        queue->remove(node);
+                        node.status = wait_status::closed;
+                        node.next = std::exchange(woken, &node);
+                    }
+                }
+                waiting_senders.store(0, std::memory_order_relaxed);
+                waiting_receivers.store(0, std::memory_order_relaxed);
+            }
+            wake_all(woken);
+        }
+
+        bool is_closed() const noexcept { return closed.load(std::memory_order_acquire); }
+
+    private:
+        // Dekker style handshake with serve_*(): the waiting count is published before
+        // retrying the ring, and the other side checks the count after touching the ring.
+        template<typename Awaiter, typename Promise, typename Retry>
+        std::coroutine_handle<> suspend(Awaiter& node, waiter_queue& queue, std::atomic<std::size_t>& waiting,
+            std::coroutine_handle<Promise> handle, Retry retry) noexcept {
+            std::inplace_stop_token token;
+            if constexpr (stoppable_promise<Promise>) {
+                token = env::get_stop_token(handle.promise().get_env());
+                node.stopped = &default_unhandled_stopped_handler<Promise>;
+            }
+            node.handle = handle;
+            node.home = details::home_scheduler(handle);
+            if (token.stop_possible()) {
+                // a stop before the node is queued is caught below
+                node.on_stop.emplace(token, cancel_fn<Awaiter>{ &node });
+            }
+
+            {
+                std::scoped_lock lock(mutex);
+                waiting.fetch_add(1, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (retry()) {
+                    node.status = wait_status::done;
+                } else if (closed.load(std::memory_order_relaxed)) {
+                    node.status = wait_status::closed;
+                } else if (!token.stop_requested()) {
+                    queue.push_back(node);
+                    return std::noop_coroutine(); // the node may be resumed once the lock is released
+                }
+                waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if (node.status == wait_status::waiting) {
+                node.on_stop.reset();
+                return node.stopped(handle.address());
+            }
+            if (node.status == wait_status::done) {
+                // served without waiting, pass the progress on
+                if constexpr (std::same_as<Awaiter, send_awaiter>) {
+                    serve_receivers();
+                } else {
+                    serve_senders();
+                }
+            }
+            return handle;
+        }
+
+        // Hand elements to waiting receivers, after an element is pushed.
+        void serve_receivers() noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting_receivers.load(std::memory_order_seq_cst) == 0) {
+                return;
+            }
+            waiter* woken = nullptr;
+            {
+                std::scoped_lock lock(mutex);
+                while (!receivers.empty()) {
+                    auto& node = static_cast<receive_awaiter&>(*receivers.front());
+                    if (!ring.try_pop(node.value)) {
+                        break;
+                    }
+                    receivers.remove(node);
+                    waiting_receivers.fetch_sub(1, std::memory_order_relaxed);
+                    node.status = wait_status::done;
+                    node.next = std::exchange(woken, static_cast<waiter*>(&node));
+                }
+            }
+            if (woken != nullptr) {
+                wake_all(woken);
+                serve_senders(); // cells were freed
+            }
+        }
+
+        // Move values of waiting senders into the ring, after an element is popped.
+        void serve_senders() noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting_senders.load(std::memory_order_seq_cst) == 0) {
+                return;
+            }
+            waiter* woken = nullptr;
+            {
+                std::scoped_lock lock(mutex);
+                while (!senders.empty()) {
+                    auto& node = static_cast<send_awaiter&>(*senders.front());
+                    if (!ring.try_push(node.value)) {
+                        break;
+                    }
+                    senders.remove(node);
+                    waiting_senders.fetch_sub(1, std::memory_order_relaxed);
+                    node.status = wait_status::done;
+                    node.next = std::exchange(woken, static_cast<waiter*>(&node));
+                }
+            }
+            if (woken != nullptr) {
+                wake_all(woken);
+                serve_receivers(); // elements were added
+            }
+        }
+
+        static void wake_all(waiter* node) noexcept {
+            while (node != nullptr) {
+                waiter& current = *std::exchange(node, node->next);
+                // the node is gone once its coroutine runs
+                const scheduler_ref home = current.home;
+                home.post(current.handle);
+            }
+        }
+
+        template<typename Awaiter>
+        void cancel(Awaiter& node) noexcept {
+            {
+                std::scoped_lock lock(mutex);
+                if (!node.queued) {
+                    return; // served, closed, or not queued yet
+                }
+                (std::same_as<Awaiter, send_awaiter> ? senders : receivers).remove(node);
+                (std::same_as<Awaiter, send_awaiter> ? waiting_senders : waiting_receivers)
+                    .fetch_sub(1, std::memory_order_relaxed);
+            }
+            // may destroy the node along with this callback, which is fine on this thread
+            node.stopped(node.handle.address()).resume();
+        }
+
+        details::mpmc_ring<T, N> ring;
+
+        std::atomic<bool> closed = false;
+        alignas(64) std::atomic<std::size_t> waiting_senders = 0;
+        alignas(64) std::atomic<std::size_t> waiting_receivers = 0;
+
+        std::mutex mutex;
+        waiter_queue senders;
+        waiter_queue receivers;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_CHANNEL_H
@@ -0,0 +1,120 @@
+#pragma once
+#ifndef COCORO_COROTRACE_DUMP_H
+#define COCORO_COROTRACE_DUMP_H 1
+
+#ifndef COCORO_ENABLE_COROTRACE_DUMP
+#error "cocoro/corotrace_dump.hpp needs COCORO_ENABLE_COROTRACE_DUMP, see the corotrace_dump option in xmake.lua"
+#endif
+
+#ifdef COCORO_DISABLE_TRACE
+#error "the corotrace dump walks corotrace chains, it cannot be used with COCORO_DISABLE_TRACE"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <format>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "cocoro/env/trace.hpp"
+#include "cocoro/env/live_trace.hpp"
+
+namespace cocoro::details {
+
+    // Attempts at the lock of a list before the dump moves on without it.
+    inline constexpr std::size_t dump_lock_spins = 1 << 16;
+
+    inline void dump_write(int fd, std::string_view text) noexcept {
+        while (!text.empty()) {
+            const ::ssize_t written = ::write(fd, text.data(), text.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            text.remove_prefix(static_cast<std::size_t>(written));
+        }
+    }
+
+    // Formats into a buffer on the stack and writes it out, longer output is cut.
+    template<typename... Args>
+    void dump_print(int fd, std::format_string<Args...> fmt, Args&&... args) noexcept {
+        std::array<char, 4096> buffer;
+        const auto result = std::format_to_n(buffer.data(), buffer.size(), fmt, std::forward<Args>(args)...);
+        const std::size_t size = std::min(static_cast<std::size_t>(result.size), buffer.size());
+        dump_write(fd, std::string_view(buffer.data(), size));
+        if (size != static_cast<std::size_t>(result.size)) {
+            dump_write(fd, " [cut]\n");
+        }
+    }
+
+    inline void corotrace_dump_signal_handler(int) noexcept;
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Writes the corotrace of every live coroutine to `fd`, innermost frame first.
+    // Each chain is printed once, from its leaf, i.e. the frame that awaits no traced coroutine.
+    // Coroutines that never reached a traced await, e.g. detached tasks not started yet,
+    // are only counted. Async signal safe: formatting goes to a buffer on the stack
+    // through std::format_to_n and out through write(2), locks are only tried.
+    // Meant for a hung process: frames are read while other threads may run them,
+    // so a busy process may show a frame at a stale suspension point.
+    inline void dump_all_corotraces(int fd = STDERR_FILENO) noexcept {
+        const int saved_errno = errno;
+        std::size_t shown = 0;
+        std::size_t never_suspended = 0;
+        std::size_t busy = 0;
+        details::dump_write(fd, "cocoro: live coroutines\n");
+        for (const details::live_trace_list* list = details::live_trace_list::first(); list != nullptr; list = list->next_list()) {
+            const bool walked = list->try_for_each([&](const details::live_trace_node& node) {
+                const env::inplace_trace_entry& entry = env::inplace_trace(static_cast<const env::trace_env&>(node));
+                if (entry.awaiters.load(std::memory_order_relaxed) != 0) {
+                    return; // printed as part of the chain of what it awaits
+                }
+                if (*entry.loc.function_name() == '\0') {
+                    ++never_suspended;
+                    return;
+                }
+                details::dump_print(fd, "coroutine {}:\n{}\n", ++shown, corotrace_view(&entry));
+            }, details::dump_lock_spins);
+            if (!walked) {
+                ++busy;
+            }
+        }
+        details::dump_print(fd, "cocoro: {} suspended coroutine(s), {} never suspended, {} thread list(s) busy\n",
+            shown, never_suspended, busy);
+        errno = saved_errno;
+    }
+
+    // Makes `signal` dump every live coroutine to stderr, e.g. `kill -USR1 <pid>`.
+    inline void install_corotrace_dump_handler(int signal = SIGUSR1) {
+        struct sigaction action = {};
+        action.sa_handler = &details::corotrace_dump_signal_handler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(signal, &action, nullptr) != 0) {
+            throw std::system_error(errno, std::system_category(), "sigaction");
+        }
+    }
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    inline void corotrace_dump_signal_handler(int) noexcept {
+        dump_all_corotraces(STDERR_FILENO);
+    }
+
+} // namespace cocoro::details
+
+#endif // COCORO_COROTRACE_DUMP_H
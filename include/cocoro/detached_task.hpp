@@ -4,8 +4,14 @@
 
 #include <memory>
 #include <exception>
+#include <ranges>
+#include <type_traits>
+#include <vector>
 
 #include "cocoro/env/trace.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
+#include "cocoro/utils/frame_alloc.hpp"
 
 namespace cocoro {
 
@@ -58,17 +64,44 @@ namespace cocoro {
         // Forward declaration
         inline std::coroutine_handle<> detached_task_stopped(std::coroutine_handle<> handle) noexcept;
 
-        struct detached_task_promise : public env::trace_env
+        using detached_task_env = env::composed_environment<env::default_trace_env, env::stop_token_env, env::default_metrics_env>;
+
+        struct detached_task_promise : public detached_task_env, public frame_allocator_base
         {
             using handle_type = std::coroutine_handle<detached_task_promise>;
             detached_task get_return_object() noexcept;
             void return_void() const noexcept {}
+#ifdef COCORO_OBSERVE_AWAITS
+            // Report start and completion, see details::observe_start.
+            struct initial_awaiter : std::suspend_always {
+                const detached_task_promise* self;
+
+                void await_resume() const noexcept {
+                    observe_start(*self);
+                }
+            };
+
+            struct final_awaiter : std::suspend_never {
+                const detached_task_promise* self;
+
+                bool await_ready() const noexcept {
+                    observe_complete(*self);
+                    return true;
+                }
+            };
+
+            initial_awaiter initial_suspend() const noexcept { return { {}, this }; }
+            final_awaiter final_suspend() const noexcept { return { {}, this }; } // coroutine destroyed on final suspend
+#else
             std::suspend_always initial_suspend() const noexcept { return {}; }
             std::suspend_never final_suspend() const noexcept { return {}; } // coroutine destroyed on final suspend
+#endif
 
-            using env_type = env::trace_env;
+            using env_type = detached_task_env;
             using env_type::query;
+#if !defined(COCORO_DISABLE_TRACE) || defined(COCORO_OBSERVE_AWAITS)
             using env_type::await_transform;
+#endif
 
             const env_type& get_env() const noexcept {
                 return static_cast<const env_type&>(*this);
@@ -121,6 +154,12 @@ namespace cocoro {
             std::exchange(this->handle, nullptr).resume();
         }
 
+        // start with a stop token, which coroutines awaited by this task inherit
+        void start(std::inplace_stop_token token) && {
+            this->handle.promise().set_stop_token(token);
+            std::move(*this).start();
+        }
+
         [[nodiscard]]
         handle_type to_handle() && noexcept { return std::exchange(this->handle, nullptr); }
 
@@ -128,6 +167,30 @@ namespace cocoro {
         handle_type handle = nullptr;
     };
 
+    // Starts every task of `tasks` on `sched`, handing them over in one post_batch()
+    // where the scheduler takes batches, one post() each otherwise.
+    // Every task of `tasks` is left empty, the range itself keeps its size.
+    template<typename Sched, std::ranges::input_range Tasks>
+        requires scheduler<std::remove_reference_t<Sched>>
+        && std::same_as<std::ranges::range_reference_t<Tasks>, detached_task&>
+    void spawn_batch(Sched&& sched, Tasks&& tasks) {
+        std::vector<std::coroutine_handle<>> handles;
+        if constexpr (std::ranges::sized_range<Tasks>) {
+            handles.reserve(std::ranges::size(tasks));
+        }
+        for (detached_task& task : tasks) {
+            handles.emplace_back(); // a throwing push leaves the task to destroy its coroutine
+            handles.back() = std::move(task).to_handle();
+        }
+        if constexpr (batch_scheduler<std::remove_reference_t<Sched>>) {
+            sched.post_batch(handles);
+        } else {
+            for (std::coroutine_handle<> handle : handles) {
+                sched.post(handle);
+            }
+        }
+    }
+
     namespace details {
 
         inline detached_task cleanup(std::coroutine_handle<> handle) {
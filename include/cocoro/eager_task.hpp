@@ -0,0 +1,223 @@
+#pragma once
+#ifndef COCORO_EAGER_TASK_H
+#define COCORO_EAGER_TASK_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <source_location>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/symres.hpp"
+#include "cocoro/utils/frame_alloc.hpp"
+#include "cocoro/env/trace.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
+
+namespace cocoro {
+
+    namespace details {
+
+        using eager_task_env = env::composed_environment<env::default_trace_env, env::affine_env,
+            env::stop_token_env, env::default_metrics_env>;
+
+        // Raises a flag before the wrapped awaiter suspends the coroutine,
+        // and reports the await as observed_awaiter does.
+        template<typename Awaiter, typename Promise>
+        struct suspension_tracking_awaiter
+        {
+            observed_awaiter<Awaiter, Promise> observed;
+            bool& suspended;
+
+            decltype(auto) await_ready() { return observed.await_ready(); }
+
+            template<typename OtherPromise>
+            decltype(auto) await_suspend(std::coroutine_handle<OtherPromise> handle) {
+                suspended = true;
+                return observed.await_suspend(handle);
+            }
+
+            decltype(auto) await_resume() { return observed.await_resume(); }
+        };
+
+    } // namespace cocoro::details
+
+    // Task that starts running as soon as it is called, up to its first real suspension.
+    // Awaiting one that already completed does not suspend at all, which suits
+    // mostly synchronous paths such as cache hits.
+    // Nobody awaits it yet when it starts, so it runs with a default env:
+    // its trace starts afresh and it is not stoppable from the awaiting coroutine.
+    // It must be awaited before it is destroyed, unless it has completed.
+    template<typename ResultType>
+    class [[nodiscard]] eager_task
+    {
+    public:
+        struct promise_type;
+        using result_type = ResultType;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        struct promise_type :
+            public details::eager_task_env,
+            public symmetric_result<result_type>,
+            public frame_allocator_base
+        {
+            using env_type = details::eager_task_env;
+            using env_type::query;
+
+            const env_type& get_env() const noexcept { return *this; }
+
+            env_type& get_mut_env() noexcept { return *this; }
+
+            eager_task get_return_object() noexcept {
+                return eager_task(handle_type::from_promise(*this));
+            }
+
+#ifdef COCORO_OBSERVE_AWAITS
+            // Reports the start on the call, see details::observe_start.
+            struct initial_awaiter : std::suspend_never {
+                const promise_type* self;
+
+                void await_resume() const noexcept {
+                    details::observe_start(*self);
+                }
+            };
+
+            initial_awaiter initial_suspend() const noexcept { return { {}, this }; }
+#else
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+#endif
+
+            // Until the body first suspends nobody can await it, so completion needs no handshake.
+            template<typename T>
+            auto await_transform(T&& awaitable,
+                std::source_location loc = std::source_location::current()) {
+                this->set_suspension_point_info(std::move(loc));
+                using awaiter_type = decltype(details::get_awaiter(std::forward<T>(awaitable)));
+                return details::suspension_tracking_awaiter<awaiter_type, promise_type>{
+                    { details::get_awaiter(std::forward<T>(awaitable)), *this }, suspended };
+            }
+
+            struct final_awaiter : std::suspend_always {
+                std::coroutine_handle<> await_suspend(handle_type handle) noexcept {
+                    details::observe_complete(handle.promise());
+                    return handle.promise().complete();
+                }
+            };
+
+            final_awaiter final_suspend() const noexcept { return {}; }
+
+            std::coroutine_handle<> unhandled_stopped() noexcept {
+                details::trace_leave();
+                stopped = true;
+                return complete();
+            }
+
+            // Publish completion; whoever comes second, this or the awaiter, continues the parent.
+            std::coroutine_handle<> complete() noexcept {
+                if (!suspended) {
+                    state.store(completed_tag(), std::memory_order_release);
+                    return std::noop_coroutine();
+                }
+                void* parent = state.exchange(completed_tag(), std::memory_order_acq_rel);
+                if (parent == nullptr) {
+                    return std::noop_coroutine(); // not awaited yet
+                }
+                if (stopped) {
+                    return parent_stopped(parent);
+                }
+                return details::continue_on(home, std::coroutine_handle<>::from_address(parent));
+            }
+
+            bool completed() const noexcept {
+                return state.load(std::memory_order_acquire) == completed_tag();
+            }
+
+            void* completed_tag() const noexcept { return const_cast<promise_type*>(this); }
+
+            // null while running unawaited, the awaiting coroutine, or completed_tag()
+            std::atomic<void*> state = nullptr;
+            bool suspended = false;
+            bool stopped = false;
+            scheduler_ref home = {};
+            stopped_handler_t parent_stopped = &terminate_unhandled_stopped;
+        };
+
+        eager_task() = delete;
+        eager_task(const eager_task&) = delete;
+        eager_task& operator=(const eager_task&) = delete;
+
+        ~eager_task() {
+            if (handle != nullptr) {
+                handle.destroy();
+            }
+        }
+
+        eager_task(eager_task&& other) noexcept :
+            handle(std::exchange(other.handle, nullptr))
+        {}
+
+        eager_task& operator=(eager_task&& other) noexcept {
+            auto(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(eager_task& other) noexcept {
+            std::ranges::swap(handle, other.handle);
+        }
+
+        bool is_ready() const noexcept { return handle.promise().completed(); }
+
+        class [[nodiscard]] eager_task_awaiter
+        {
+        public:
+            // completed synchronously, no suspension
+            bool await_ready() const noexcept {
+                const promise_type& promise = handle.promise();
+                return promise.completed() && !promise.stopped;
+            }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) noexcept {
+                promise_type& promise = handle.promise();
+                promise.home = details::home_scheduler(caller);
+                if constexpr (unhandled_stopped_aware_promise<Promise>) {
+                    promise.parent_stopped = &default_unhandled_stopped_handler<Promise>;
+                }
+                void* expected = nullptr;
+                if (promise.state.compare_exchange_strong(expected, caller.address(), std::memory_order_acq_rel)) {
+                    return std::noop_coroutine(); // resumed on completion
+                }
+                // completed meanwhile
+                return promise.stopped ? promise.parent_stopped(caller.address()) : caller;
+            }
+
+            result_type await_resume() {
+                return handle.promise().result();
+            }
+
+            ~eager_task_awaiter() {
+                if (handle != nullptr) {
+                    handle.destroy();
+                }
+            }
+
+        private:
+            friend eager_task;
+            explicit eager_task_awaiter(handle_type handle) noexcept : handle(handle) {}
+
+            handle_type handle = nullptr;
+        };
+
+        eager_task_awaiter operator co_await() && noexcept {
+            return eager_task_awaiter(std::exchange(handle, nullptr));
+        }
+
+    private:
+        explicit eager_task(handle_type handle) noexcept : handle(handle) {}
+
+        handle_type handle = nullptr;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_EAGER_TASK_H
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef COCORO_ACTIVE_TRACE_H
+#define COCORO_ACTIVE_TRACE_H 1
+
+#ifdef COCORO_ENABLE_PROFILER
+#include <atomic>
+#endif
+
+// Library coroutines report their starts, suspensions and resumptions
+// whenever something listens: the sampling profiler or task metrics.
+#if defined(COCORO_ENABLE_PROFILER) || defined(COCORO_ENABLE_METRICS)
+#define COCORO_OBSERVE_AWAITS 1
+#endif
+
+namespace cocoro::env {
+
+    // Forward declaration
+    struct inplace_trace_entry;
+
+} // namespace cocoro::env
+
+namespace cocoro::details {
+
+    // Library coroutines report the trace entry of the coroutine running on their thread:
+    // entering on start and on every resumption from an await, leaving on every suspension.
+    // The sampling profiler reads it from its signal handler, so a left entry
+    // is never read again and the frame holding it may be destroyed.
+#ifdef COCORO_ENABLE_PROFILER
+    inline thread_local constinit std::atomic<const env::inplace_trace_entry*> active_trace = nullptr;
+
+    inline void trace_enter(const env::inplace_trace_entry* entry) noexcept {
+        active_trace.store(entry, std::memory_order_relaxed);
+    }
+
+    inline void trace_leave() noexcept {
+        active_trace.store(nullptr, std::memory_order_relaxed);
+    }
+#else
+    constexpr void trace_enter(const env::inplace_trace_entry*) noexcept {}
+    constexpr void trace_leave() noexcept {}
+#endif
+
+    // Completion of a library coroutine at its final suspend, see trace.hpp.
+#ifdef COCORO_OBSERVE_AWAITS
+    template<typename Promise>
+    void observe_complete(const Promise& promise) noexcept;
+#else
+    template<typename Promise>
+    constexpr void observe_complete(const Promise&) noexcept {}
+#endif
+
+} // namespace cocoro::details
+
+#endif // COCORO_ACTIVE_TRACE_H
@@ -2,6 +2,228 @@
 #ifndef COCORO_SCHEDULER_AFFINE_H
 #define COCORO_SCHEDULER_AFFINE_H 1
 
-// TODO
+#include <concepts>
+#include <coroutine>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "./env.hpp"
+
+namespace cocoro {
+
+    // A scheduler resumes posted coroutines on its own execution resource.
+    // Posting cannot fail: a scheduler that cannot queue a coroutine, e.g. out of memory, terminates.
+    template<typename Sched>
+    concept scheduler = requires (Sched& sched, std::coroutine_handle<> handle) {
+        { sched.post(handle) } noexcept;
+    };
+
+    // A scheduler that also takes many coroutines at once, at the cost of about one post.
+    template<typename Sched>
+    concept batch_scheduler = scheduler<Sched>
+        && requires (Sched& sched, std::span<const std::coroutine_handle<>> handles) {
+            { sched.post_batch(handles) } noexcept;
+        };
+
+    // Type erased reference to a scheduler.
+    // Null reference stands for the inline scheduler, which resumes coroutines in place.
+    class scheduler_ref
+    {
+    public:
+        constexpr scheduler_ref() = default;
+
+        template<scheduler Sched>
+            requires (not std::same_as<Sched, scheduler_ref>)
+        scheduler_ref(Sched& sched) noexcept :
+            self(std::addressof(sched)),
+            post_fn(&post_to<Sched>)
+        {}
+
+        bool is_inline() const noexcept { return self == nullptr; }
+
+        void post(std::coroutine_handle<> handle) const noexcept {
+            if (self == nullptr) {
+                handle.resume();
+            } else {
+                post_fn(self, handle);
+            }
+        }
+
+        class schedule_awaiter;
+
+        // co_await the result of this function to continue on the scheduler
+        schedule_awaiter schedule() const noexcept;
+
+        friend bool operator==(const scheduler_ref&, const scheduler_ref&) = default;
+
+    private:
+        using post_fn_t = void(*)(void*, std::coroutine_handle<>) noexcept;
+
+        template<typename Sched>
+        static void post_to(void* self, std::coroutine_handle<> handle) noexcept {
+            static_cast<Sched*>(self)->post(handle);
+        }
+
+        void* self = nullptr;
+        post_fn_t post_fn = nullptr;
+    };
+
+    class [[nodiscard]] scheduler_ref::schedule_awaiter
+    {
+    public:
+        bool await_ready() const noexcept { return sched.is_inline(); }
+        void await_suspend(std::coroutine_handle<> handle) const noexcept { sched.post(handle); }
+        void await_resume() const noexcept {}
+
+    private:
+        friend scheduler_ref;
+        explicit schedule_awaiter(scheduler_ref sched) noexcept : sched(sched) {}
+
+        scheduler_ref sched;
+    };
+
+    inline scheduler_ref::schedule_awaiter scheduler_ref::schedule() const noexcept {
+        return schedule_awaiter(*this);
+    }
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    // Points into the scheduler driving the thread, which outlives everything running on it.
+    inline thread_local constinit const scheduler_ref* current_scheduler = nullptr;
+
+} // namespace cocoro::details
+
+namespace cocoro::this_thread {
+
+    // Scheduler driving the calling thread, inline scheduler if none.
+    inline scheduler_ref current_scheduler() noexcept {
+        const scheduler_ref* sched = details::current_scheduler;
+        return sched != nullptr ? *sched : scheduler_ref{};
+    }
+
+} // namespace cocoro::this_thread
+
+namespace cocoro {
+
+    // Schedulers install themselves on their worker threads with this guard.
+    // `sched` is referenced, not copied: schedulers pass a member of their own.
+    class scheduler_scope : private details::pinned
+    {
+    public:
+        explicit scheduler_scope(const scheduler_ref& sched) noexcept :
+            prev(std::exchange(details::current_scheduler, &sched))
+        {}
+
+        scheduler_scope(scheduler_ref&&) = delete;
+
+        ~scheduler_scope() { details::current_scheduler = prev; }
+
+    private:
+        const scheduler_ref* prev;
+    };
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    struct get_scheduler_fn {
+        template<env::queryable_r<get_scheduler_fn, scheduler_ref> Env>
+        constexpr scheduler_ref operator()(const Env& env) const noexcept {
+            return env.query(*this);
+        }
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro::env {
+
+    inline constexpr details::get_scheduler_fn get_scheduler{};
+
+    // Records the scheduler a coroutine should complete on, which is
+    // the scheduler its awaiter was running on when it got awaited.
+    // Only a pointer to the scheduler's own reference is kept, one word per frame.
+    class affine_env
+    {
+    public:
+        affine_env() noexcept : sched(details::current_scheduler) {}
+
+        // Inherit ctor
+        // Inheritance happens on the thread of the awaiting coroutine,
+        // so the scheduler driving this thread is preferred over the recorded one.
+        template<std::derived_from<affine_env> OtherEnv>
+        affine_env(inherit_tag, const OtherEnv& other) noexcept :
+            sched(details::current_scheduler)
+        {
+            if (sched == nullptr) {
+                sched = static_cast<const affine_env&>(other).sched;
+            }
+        }
+
+        // Fallback inherit ctor (use default ctor)
+        affine_env(inherit_tag, const auto&) noexcept : affine_env() {}
+
+        scheduler_ref query(decltype(get_scheduler)) const noexcept {
+            return sched != nullptr ? *sched : scheduler_ref{};
+        }
+
+        // For coroutines started on `home` without an awaiting coroutine to inherit from.
+        // `home` is referenced, not copied, as by scheduler_scope.
+        void set_scheduler(const scheduler_ref& home) noexcept { sched = &home; }
+
+        void set_scheduler(scheduler_ref&&) = delete;
+
+    private:
+        const scheduler_ref* sched;
+    };
+
+} // namespace cocoro::env
+
+namespace cocoro::details {
+
+    // Continue with `cont` on `home`, by symmetric transfer when already running there.
+    inline std::coroutine_handle<> continue_on(scheduler_ref home, std::coroutine_handle<> cont) noexcept {
+        if (home.is_inline() || home == this_thread::current_scheduler()) {
+            return cont;
+        }
+        home.post(cont);
+        return std::noop_coroutine();
+    }
+
+    // Scheduler to wake a suspending coroutine on, taken from its env when it has one.
+    template<typename Promise>
+    scheduler_ref home_scheduler(std::coroutine_handle<Promise> handle) noexcept {
+        if constexpr (env::env_aware<Promise>) {
+            if constexpr (env::queryable_r<env::env_t<Promise>, decltype(env::get_scheduler), scheduler_ref>) {
+                return env::get_scheduler(handle.promise().get_env());
+            }
+        }
+        return this_thread::current_scheduler();
+    }
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    template<typename Promise>
+    concept affine_promise = continuable_promise<Promise> && env::env_aware<Promise>
+        && env::queryable_r<env::env_t<Promise>, decltype(env::get_scheduler), scheduler_ref>;
+
+    // Final awaiter resuming the continuation on the scheduler recorded in promise env.
+    // Symmetric transfer is kept when the coroutine completes on that very scheduler.
+    struct affine_final_awaiter : std::suspend_always {
+        template<affine_promise Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto& promise = handle.promise();
+            details::observe_complete(promise);
+            // frame may be resumed and destroyed by the scheduler once posted
+            return details::continue_on(env::get_scheduler(promise.get_env()), promise.continuation());
+        }
+    };
+
+} // namespace cocoro
 
 #endif // COCORO_SCHEDULER_AFFINE_H
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef COCORO_LIVE_TRACE_H
+#define COCORO_LIVE_TRACE_H 1
+
+#include <atomic>
+#include <cstddef>
+
+#include "cocoro/utils/basic.hpp"
+
+namespace cocoro::details {
+
+    // Forward declaration
+    class live_trace_list;
+
+    // Links of a trace_env into the list of the thread that set it up.
+    struct live_trace_node {
+        live_trace_node* prev_live = nullptr;
+        live_trace_node* next_live = nullptr;
+        live_trace_list* list = nullptr;
+    };
+
+    // Intrusive list of the trace envs set up by one thread, walked by dump_all_corotraces().
+    // Lists are never freed: a list outlives its thread, which may leave frames linked in it,
+    // and is handed to the next thread to start. Frames unlink from whichever thread destroys
+    // them, so every access is under the lock of the list; linking never allocates.
+    class live_trace_list : private pinned
+    {
+    public:
+        static live_trace_list& local() {
+            thread_local constinit live_trace_list* current = nullptr;
+            if (current == nullptr) [[unlikely]] {
+                current = &acquire();
+                thread_local const releaser release(*current);
+            }
+            return *current;
+        }
+
+        void link(live_trace_node& node) noexcept {
+            const spin_guard guard(lock);
+            node.list = this;
+            node.next_live = head;
+            if (head != nullptr) {
+                head->prev_live = &node;
+            }
+            head = &node;
+        }
+
+        static void unlink(live_trace_node& node) noexcept {
+            live_trace_list& self = *node.list;
+            const spin_guard guard(self.lock);
+            if (node.prev_live != nullptr) {
+                node.prev_live->next_live = node.next_live;
+            } else {
+                self.head = node.next_live;
+            }
+            if (node.next_live != nullptr) {
+                node.next_live->prev_live = node.prev_live;
+            }
+        }
+
+        // Calls `fn` on every node under the lock, async signal safe as long as `fn` is.
+        // Gives up and returns false if the lock stays taken for `spins` attempts,
+        // as it does when the interrupted thread itself holds it.
+        template<typename Fn>
+        bool try_for_each(Fn&& fn, std::size_t spins) const noexcept {
+            while (lock.test_and_set(std::memory_order_acquire)) {
+                if (spins-- == 0) {
+                    return false;
+                }
+            }
+            for (const live_trace_node* node = head; node != nullptr; node = node->next_live) {
+                fn(*node);
+            }
+            lock.clear(std::memory_order_release);
+            return true;
+        }
+
+        static const live_trace_list* first() noexcept { return all.load(std::memory_order_acquire); }
+
+        const live_trace_list* next_list() const noexcept { return next; }
+
+    private:
+        // Hands the list over once its thread exits.
+        struct releaser : private pinned {
+            live_trace_list& list;
+            explicit releaser(live_trace_list& list) noexcept : list(list) {}
+            ~releaser() { list.owned.store(false, std::memory_order_release); }
+        };
+
+        live_trace_list() = default;
+
+        // A list left by an exited thread, or a new one, allocated once per thread.
+        static live_trace_list& acquire() {
+            for (live_trace_list* list = all.load(std::memory_order_acquire); list != nullptr; list = list->next) {
+                if (!list->owned.load(std::memory_order_relaxed)
+                    && !list->owned.exchange(true, std::memory_order_acquire)) {
+                    return *list;
+                }
+            }
+            live_trace_list* list = new live_trace_list();
+            list->owned.store(true, std::memory_order_relaxed);
+            list->next = all.load(std::memory_order_relaxed);
+            while (!all.compare_exchange_weak(list->next, list,
+                std::memory_order_release, std::memory_order_relaxed)) {}
+            return *list;
+        }
+
+        static inline std::atomic<live_trace_list*> all = nullptr;
+
+        mutable std::atomic_flag lock;
+        live_trace_node* head = nullptr;
+        std::atomic<bool> owned = false;
+        live_trace_list* next = nullptr; // set once before publication
+    };
+
+} // namespace cocoro::details
+
+#endif // COCORO_LIVE_TRACE_H
@@ -0,0 +1,397 @@
+#pragma once
+#ifndef COCORO_METRICS_H
+#define COCORO_METRICS_H 1
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cocoro/utils/basic.hpp"
+#include "./env.hpp"
+
+namespace cocoro {
+
+    // Forward declaration
+    class metrics_histogram_snapshot;
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    // Log-linear buckets in the manner of HdrHistogram: 16 sub-buckets per power of two,
+    // about 6% relative precision over the whole 64 bit range, values below 16 are exact.
+    struct metrics_buckets {
+        static constexpr unsigned sub_bucket_bits = 4;
+        static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+        static constexpr std::size_t count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+        static constexpr std::size_t index_of(std::uint64_t value) noexcept {
+            if (value < sub_buckets) {
+                return static_cast<std::size_t>(value);
+            }
+            const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - sub_bucket_bits;
+            return (shift + 1) * sub_buckets + static_cast<std::size_t>((value >> shift) & (sub_buckets - 1));
+        }
+
+        // smallest value falling into the bucket
+        static constexpr std::uint64_t lowest_of(std::size_t index) noexcept {
+            if (index < sub_buckets) {
+                return index;
+            }
+            const unsigned shift = static_cast<unsigned>(index / sub_buckets) - 1;
+            return (sub_buckets + index % sub_buckets) << shift;
+        }
+    };
+
+    // Written by its own thread only, read by snapshots from any thread,
+    // so recording is a relaxed load and store per field, never a read-modify-write.
+    class metrics_counter
+    {
+    public:
+        void add(std::uint64_t n = 1) noexcept {
+            value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        std::uint64_t load() const noexcept { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::uint64_t> value = 0;
+    };
+
+    class metrics_histogram : private pinned
+    {
+    public:
+        metrics_histogram() = default;
+
+        void record(std::uint64_t value) noexcept {
+            buckets[metrics_buckets::index_of(value)].add();
+            total.add();
+            sum.add(value);
+            if (value > max.load(std::memory_order_relaxed)) {
+                max.store(value, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        friend class cocoro::metrics_histogram_snapshot;
+
+        std::array<metrics_counter, metrics_buckets::count> buckets;
+        metrics_counter total;
+        metrics_counter sum;
+        std::atomic<std::uint64_t> max = 0;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Merged copy of histograms, values in nanoseconds unless noted otherwise.
+    class metrics_histogram_snapshot
+    {
+    public:
+        void merge(const details::metrics_histogram& histogram) noexcept {
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                buckets[i] += histogram.buckets[i].load();
+            }
+            total += histogram.total.load();
+            sum += histogram.sum.load();
+            max_value = std::max(max_value, histogram.max.load(std::memory_order_relaxed));
+        }
+
+        void merge(const metrics_histogram_snapshot& other) noexcept {
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                buckets[i] += other.buckets[i];
+            }
+            total += other.total;
+            sum += other.sum;
+            max_value = std::max(max_value, other.max_value);
+        }
+
+        std::uint64_t count() const noexcept { return total; }
+        std::uint64_t max() const noexcept { return max_value; }
+        double mean() const noexcept { return total == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(total); }
+
+        // Lower bound of the bucket holding the given percentile, in [0, 100].
+        std::uint64_t value_at_percentile(double percentile) const noexcept {
+            if (total == 0) {
+                return 0;
+            }
+            const double clamped = std::clamp(percentile, 0.0, 100.0);
+            const auto rank = std::max<std::uint64_t>(1,
+                static_cast<std::uint64_t>(clamped / 100.0 * static_cast<double>(total) + 0.5));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return details::metrics_buckets::lowest_of(i);
+                }
+            }
+            return max_value;
+        }
+
+    private:
+        std::array<std::uint64_t, details::metrics_buckets::count> buckets = {};
+        std::uint64_t total = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t max_value = 0;
+    };
+
+    struct task_metrics_snapshot {
+        std::uint64_t created = 0;
+        std::uint64_t started = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t unfinished = 0; // destroyed before completing, e.g. stopped or never started
+        metrics_histogram_snapshot start_latency;  // creation to first resume
+        metrics_histogram_snapshot suspended_time; // per task, total time suspended in awaits
+        metrics_histogram_snapshot suspensions;    // per task, number of suspending awaits
+        metrics_histogram_snapshot lifetime;       // creation to completion
+    };
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    // Metrics recorded on one thread, each event lands on the thread it happens on.
+    struct thread_task_metrics : private pinned {
+        metrics_counter created;
+        metrics_counter started;
+        metrics_counter completed;
+        metrics_counter unfinished;
+        metrics_histogram start_latency;
+        metrics_histogram suspended_time;
+        metrics_histogram suspensions;
+        metrics_histogram lifetime;
+
+        void merge_into(task_metrics_snapshot& snapshot) const noexcept {
+            snapshot.created += created.load();
+            snapshot.started += started.load();
+            snapshot.completed += completed.load();
+            snapshot.unfinished += unfinished.load();
+            snapshot.start_latency.merge(start_latency);
+            snapshot.suspended_time.merge(suspended_time);
+            snapshot.suspensions.merge(suspensions);
+            snapshot.lifetime.merge(lifetime);
+        }
+    };
+
+    // Live per thread metrics, plus what exited threads left behind.
+    class task_metrics_registry : private pinned
+    {
+    public:
+        static task_metrics_registry& instance() noexcept {
+            static task_metrics_registry registry;
+            return registry;
+        }
+
+        void attach(thread_task_metrics& metrics) {
+            std::scoped_lock lock(mutex);
+            threads.push_back(&metrics);
+        }
+
+        void retire(thread_task_metrics& metrics) {
+            std::scoped_lock lock(mutex);
+            metrics.merge_into(retired);
+            std::erase(threads, &metrics);
+        }
+
+        task_metrics_snapshot snapshot() {
+            std::scoped_lock lock(mutex);
+            task_metrics_snapshot result = retired;
+            for (const thread_task_metrics* metrics : threads) {
+                metrics->merge_into(result);
+            }
+            return result;
+        }
+
+    private:
+        task_metrics_registry() = default;
+
+        std::mutex mutex;
+        std::vector<thread_task_metrics*> threads;
+        task_metrics_snapshot retired;
+    };
+
+    class thread_task_metrics_slot : private pinned
+    {
+    public:
+        thread_task_metrics_slot() : metrics(std::make_unique<thread_task_metrics>()) {
+            task_metrics_registry::instance().attach(*metrics);
+        }
+
+        ~thread_task_metrics_slot() { task_metrics_registry::instance().retire(*metrics); }
+
+        thread_task_metrics& get() noexcept { return *metrics; }
+
+    private:
+        std::unique_ptr<thread_task_metrics> metrics;
+    };
+
+    inline thread_task_metrics& local_task_metrics() {
+        static thread_local thread_task_metrics_slot slot;
+        return slot.get();
+    }
+
+    inline std::uint64_t metrics_now() noexcept {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+} // namespace cocoro::details
+
+namespace cocoro::env {
+
+    // Forward declaration
+    class metrics_env;
+
+} // namespace cocoro::env
+
+namespace cocoro::details {
+
+    struct task_metrics_query_fn {
+        template<env::queryable_r<task_metrics_query_fn, const env::metrics_env&> Env>
+        constexpr const env::metrics_env& operator()(const Env& env) const noexcept {
+            return env.query(*this);
+        }
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro::env {
+
+    inline constexpr details::task_metrics_query_fn task_metrics{};
+
+    // Lifecycle of one coroutine: created with the env, that is when the coroutine is bound
+    // to whoever awaits or starts it; started on first resume; suspended and resumed by
+    // every await going through the await hooks of library promises; completed at final suspend.
+    // Frames destroyed without completing, e.g. stopped ones, only count as unfinished.
+    // Events are recorded on the thread they happen on.
+    class metrics_env : private details::pinned
+    {
+    public:
+        metrics_env() noexcept : created(details::metrics_now()) {
+            details::local_task_metrics().created.add();
+        }
+
+        // Inherit ctor, every coroutine counts on its own
+        metrics_env(inherit_tag, const auto&) noexcept : metrics_env() {}
+
+        ~metrics_env() {
+            if (!completed) {
+                details::local_task_metrics().unfinished.add();
+            }
+        }
+
+        const metrics_env& query(decltype(task_metrics)) const noexcept { return *this; }
+
+        // Bookkeeping through a const env, as the hooks only see get_env().
+        void on_start() const noexcept {
+            if (!started) {
+                started = true;
+                details::thread_task_metrics& metrics = details::local_task_metrics();
+                metrics.started.add();
+                metrics.start_latency.record(details::metrics_now() - created);
+            }
+        }
+
+        void on_suspend() const noexcept { suspended_at = details::metrics_now(); }
+
+        void on_resume() const noexcept {
+            suspended_total += details::metrics_now() - suspended_at;
+            ++suspension_count;
+        }
+
+        void on_complete() const noexcept {
+            completed = true;
+            details::thread_task_metrics& metrics = details::local_task_metrics();
+            metrics.completed.add();
+            metrics.lifetime.record(details::metrics_now() - created);
+            metrics.suspended_time.record(suspended_total);
+            metrics.suspensions.record(suspension_count);
+        }
+
+    private:
+        std::uint64_t created;
+        mutable std::uint64_t suspended_at = 0;
+        mutable std::uint64_t suspended_total = 0;
+        mutable std::uint32_t suspension_count = 0;
+        mutable bool started = false;
+        mutable bool completed = false;
+    };
+
+    // Stand-in for metrics_env when metrics are compiled out, takes no space in the frame.
+    class no_metrics_env
+    {
+    public:
+        no_metrics_env() = default;
+        no_metrics_env(inherit_tag, const auto&) noexcept {}
+
+    private:
+        // composed_environment pulls in a query from every env
+        struct no_query {};
+
+    public:
+        void query(no_query) const noexcept {}
+    };
+
+    // Define COCORO_ENABLE_METRICS to record task metrics from library coroutines.
+#ifdef COCORO_ENABLE_METRICS
+    using default_metrics_env = metrics_env;
+#else
+    using default_metrics_env = no_metrics_env;
+#endif
+
+} // namespace cocoro::env
+
+namespace cocoro::details {
+
+    template<typename Promise>
+    concept metrics_promise = env::env_aware<Promise>
+        && env::queryable_r<env::env_t<Promise>, decltype(env::task_metrics), const env::metrics_env&>;
+
+    template<typename Promise>
+    void metrics_on_start(const Promise& promise) noexcept {
+        if constexpr (metrics_promise<Promise>) {
+            env::task_metrics(promise.get_env()).on_start();
+        }
+    }
+
+    template<typename Promise>
+    void metrics_on_suspend(const Promise& promise) noexcept {
+        if constexpr (metrics_promise<Promise>) {
+            env::task_metrics(promise.get_env()).on_suspend();
+        }
+    }
+
+    template<typename Promise>
+    void metrics_on_resume(const Promise& promise) noexcept {
+        if constexpr (metrics_promise<Promise>) {
+            env::task_metrics(promise.get_env()).on_resume();
+        }
+    }
+
+    template<typename Promise>
+    void metrics_on_complete(const Promise& promise) noexcept {
+        if constexpr (metrics_promise<Promise>) {
+            env::task_metrics(promise.get_env()).on_complete();
+        }
+    }
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Merges the metrics of every thread, live or exited, into one snapshot.
+    inline task_metrics_snapshot snapshot_task_metrics() {
+        return details::task_metrics_registry::instance().snapshot();
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_METRICS_H
@@ -2,13 +2,104 @@
 #ifndef COCORO_ENVIRONMENT_CANCELLATION_H
 #define COCORO_ENVIRONMENT_CANCELLATION_H 1
 
+#include <coroutine>
+#include <stop_token>
+#include <utility>
+
 #include "cocoro/utils/basic.hpp"
 #include "./env.hpp"
 
+namespace cocoro::details {
+
+    struct get_stop_token_fn {
+        template<env::queryable_r<get_stop_token_fn, std::inplace_stop_token> Env>
+        constexpr std::inplace_stop_token operator()(const Env& env) const noexcept {
+            return env.query(*this);
+        }
+
+        // Environments without stop token are never stopped
+        template<typename Env>
+        constexpr std::inplace_stop_token operator()(const Env&) const noexcept {
+            return {};
+        }
+    };
+
+} // namespace cocoro::details
+
 namespace cocoro::env {
 
-    // TODO
+    inline constexpr details::get_stop_token_fn get_stop_token{};
+
+    class stop_token_env
+    {
+    public:
+        stop_token_env() = default;
+
+        // Inherit ctor
+        template<env::queryable_r<decltype(get_stop_token), std::inplace_stop_token> OtherEnv>
+        stop_token_env(inherit_tag, const OtherEnv& other) noexcept
+            : token(get_stop_token(other))
+        {}
+
+        // Fallback inherit ctor (use default ctor)
+        stop_token_env(inherit_tag, const auto&) noexcept : stop_token_env() {}
+
+        std::inplace_stop_token query(decltype(get_stop_token)) const noexcept {
+            return token;
+        }
+
+        // Coroutines awaited from now on inherit the new token.
+        void set_stop_token(std::inplace_stop_token new_token) noexcept {
+            token = new_token;
+        }
+
+    private:
+        std::inplace_stop_token token = {};
+    };
 
 } // namespace cocoro::env
 
+namespace cocoro {
+
+    template<typename Promise>
+    concept stoppable_promise = unhandled_stopped_aware_promise<Promise> && env::env_aware<Promise>;
+
+    class [[nodiscard]] cancellation_point_awaiter
+    {
+    public:
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<stoppable_promise Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            if (env::get_stop_token(handle.promise().get_env()).stop_requested()) {
+                // unwind without exception, frame is destroyed by its owner
+                return handle.promise().unhandled_stopped();
+            }
+            return handle; // resume immediately
+        }
+
+        constexpr void await_resume() const noexcept {}
+    };
+
+    // co_await the result of this function to stop the current coroutine if stop is requested
+    inline cancellation_point_awaiter cancellation_point() noexcept { return {}; }
+
+    class [[nodiscard]] stopped_awaiter
+    {
+    public:
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<unhandled_stopped_aware_promise Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().unhandled_stopped();
+        }
+
+        [[noreturn]] void await_resume() const noexcept { std::unreachable(); }
+    };
+
+    // co_await the result of this function to stop the current coroutine unconditionally
+    inline stopped_awaiter stopped() noexcept { return {}; }
+
+} // namespace cocoro
+
 #endif // COCORO_ENVIRONMENT_CANCELLATION_H
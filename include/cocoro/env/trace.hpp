@@ -11,14 +11,29 @@
 #include <string>
 #include <format>
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
 
 #include "./env.hpp"
+#include "./active_trace.hpp"
+#include "./metrics.hpp"
+#ifdef COCORO_ENABLE_COROTRACE_DUMP
+#include "./live_trace.hpp"
+#endif
 
 namespace cocoro::env {
 
     struct inplace_trace_entry {
         const inplace_trace_entry* prev = nullptr;
         std::source_location loc = {};
+#ifdef COCORO_ENABLE_COROTRACE_DUMP
+        // Live entries continuing from this one, the dump prints chains from leaves only.
+        mutable std::atomic<std::uint32_t> awaiters = 0;
+#endif
     };
 
 } // namespace cocoro::env
@@ -44,6 +59,81 @@ namespace cocoro::env {
 
 } // namespace cocoro::env
 
+namespace cocoro::details {
+
+    // Trace entry of a promise, null for untraced ones.
+    template<typename Promise>
+    const env::inplace_trace_entry* trace_entry_of(const Promise& promise) noexcept {
+        if constexpr (env::traceable_promise<Promise>) {
+            return &env::inplace_trace(promise.get_env());
+        } else {
+            return nullptr;
+        }
+    }
+
+    // Start, suspension and resumption of a library coroutine, reported to the
+    // sampling profiler (see active_trace.hpp) and to task metrics (see metrics.hpp).
+    template<typename Promise>
+    void observe_start(const Promise& promise) noexcept {
+        metrics_on_start(promise);
+        trace_enter(trace_entry_of(promise));
+    }
+
+    template<typename Promise>
+    void observe_suspend(const Promise& promise) noexcept {
+        metrics_on_suspend(promise);
+        trace_leave();
+    }
+
+    template<typename Promise>
+    void observe_resume(const Promise& promise) noexcept {
+        metrics_on_resume(promise);
+        trace_enter(trace_entry_of(promise));
+    }
+
+#ifdef COCORO_OBSERVE_AWAITS
+    template<typename Promise>
+    void observe_complete(const Promise& promise) noexcept {
+        metrics_on_complete(promise);
+        trace_leave();
+    }
+#endif
+
+    // Reports the awaiting coroutine suspending and resuming, awaits that never
+    // reach await_suspend report nothing.
+    template<typename Awaiter, typename Promise>
+    struct observed_awaiter
+    {
+        Awaiter awaiter;
+        const Promise& promise;
+        bool has_suspended = false;
+
+        decltype(auto) await_ready() { return awaiter.await_ready(); }
+
+        template<typename OtherPromise>
+        decltype(auto) await_suspend(std::coroutine_handle<OtherPromise> handle) {
+            has_suspended = true;
+            observe_suspend(promise); // may be resumed elsewhere before await_suspend returns
+            return awaiter.await_suspend(handle);
+        }
+
+        decltype(auto) await_resume() {
+            if (has_suspended) {
+                observe_resume(promise);
+            }
+            return awaiter.await_resume();
+        }
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro::details {
+
+    template<typename Trace>
+    class current_trace_awaiter;
+
+} // namespace cocoro::details
+
 namespace cocoro {
 
     class corotrace_entry
@@ -78,34 +168,144 @@ namespace cocoro {
         std::uint_least32_t column = 0;
     };
 
-    class corotrace
+    // Non-owning entry, refers to a std::source_location with static storage.
+    class corotrace_entry_view
     {
     public:
-        corotrace() = default;
-        corotrace(const corotrace&) = default;
-        corotrace& operator=(const corotrace&) = default;
-        corotrace(corotrace&&) = default;
-        corotrace& operator=(corotrace&&) = default;
+        constexpr corotrace_entry_view() = default;
 
-        using srcloc = corotrace_entry::srcloc;
+        constexpr explicit corotrace_entry_view(const std::source_location& loc) noexcept : loc(loc) {}
+
+        constexpr std::string_view coroutine_name() const noexcept { return loc.function_name(); }
+        constexpr std::string_view source_file() const noexcept { return loc.file_name(); }
+        constexpr std::uint_least32_t source_line() const noexcept { return loc.line(); }
+        constexpr std::uint_least32_t source_column() const noexcept { return loc.column(); }
+
+        constexpr const std::source_location& location() const noexcept { return loc; }
+
+        std::string description() const;
+
+    private:
+        std::source_location loc = {};
+    };
 
-        class [[nodiscard]] current_trace_awaiter
+    template<typename Entry>
+    concept corotrace_entry_like = requires (const Entry& entry) {
+        { entry.coroutine_name() } -> std::convertible_to<std::string_view>;
+        { entry.source_file() } -> std::convertible_to<std::string_view>;
+        { entry.source_line() } -> std::convertible_to<std::uint_least32_t>;
+        { entry.source_column() } -> std::convertible_to<std::uint_least32_t>;
+    };
+
+    // Non-owning corotrace, walks the chain of suspended frames lazily.
+    // Only valid while those frames stay suspended, i.e. until the capturing coroutine
+    // suspends again or returns. Capturing and iterating never allocates.
+    class corotrace_view
+    {
+    public:
+        class iterator
         {
         public:
-            constexpr bool await_ready() const noexcept { return false; }
+            using value_type = corotrace_entry_view;
+            using difference_type = std::ptrdiff_t;
 
-            template<env::traceable_promise Promise>
-            bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
-                entry = &env::inplace_trace(handle.promise().get_env());
-                return false; // resume immediately
+            constexpr iterator() = default;
+
+            constexpr value_type operator*() const noexcept { return value_type(entry->loc); }
+
+            constexpr iterator& operator++() noexcept {
+                entry = entry->prev;
+                return *this;
             }
 
-            corotrace await_resume() const { return corotrace(entry); }
+            constexpr iterator operator++(int) noexcept {
+                iterator old = *this;
+                ++*this;
+                return old;
+            }
+
+            friend constexpr bool operator==(const iterator&, const iterator&) = default;
 
         private:
+            friend corotrace_view;
+            constexpr explicit iterator(const env::inplace_trace_entry* entry) noexcept : entry(entry) {}
+
             const env::inplace_trace_entry* entry = nullptr;
         };
 
+        constexpr corotrace_view() = default;
+
+        constexpr explicit corotrace_view(const env::inplace_trace_entry* head) noexcept : head(head) {}
+
+        constexpr iterator begin() const noexcept { return iterator(head); }
+        constexpr iterator end() const noexcept { return iterator(); }
+        constexpr bool empty() const noexcept { return head == nullptr; }
+
+        // O(depth)
+        constexpr std::size_t size() const noexcept {
+            return static_cast<std::size_t>(std::ranges::distance(begin(), end()));
+        }
+
+        // co_await the result of this function to get a view of the current corotrace
+        static constexpr details::current_trace_awaiter<corotrace_view> current() noexcept;
+
+    private:
+        const env::inplace_trace_entry* head = nullptr;
+    };
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    // Awaitable of corotrace::current() and friends, Trace is constructed from a corotrace_view.
+    template<typename Trace>
+    class [[nodiscard]] current_trace_awaiter
+    {
+    public:
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            if constexpr (env::traceable_promise<Promise>) {
+                entry = &env::inplace_trace(handle.promise().get_env());
+            }
+            return false; // resume immediately, untraced coroutines get an empty trace
+        }
+
+        Trace await_resume() const noexcept(std::is_nothrow_constructible_v<Trace, corotrace_view>) {
+            return Trace(corotrace_view(entry));
+        }
+
+    private:
+        const env::inplace_trace_entry* entry = nullptr;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    constexpr details::current_trace_awaiter<corotrace_view> corotrace_view::current() noexcept { return {}; }
+
+    class corotrace
+    {
+    public:
+        corotrace() = default;
+        corotrace(const corotrace&) = default;
+        corotrace& operator=(const corotrace&) = default;
+        corotrace(corotrace&&) = default;
+        corotrace& operator=(corotrace&&) = default;
+
+        // Copies every entry, valid after the traced frames are gone.
+        explicit corotrace(corotrace_view view) {
+            for (const corotrace_entry_view entry : view) {
+                entries.emplace_back(entry.location());
+            }
+        }
+
+        using srcloc = corotrace_entry::srcloc;
+
+        using current_trace_awaiter = details::current_trace_awaiter<corotrace>;
+
         // co_await the result of this function to get the current corotrace
         static current_trace_awaiter current() noexcept { return {}; }
 
@@ -115,15 +315,72 @@ namespace cocoro {
         std::size_t size() const noexcept { return entries.size(); }
 
     private:
-        friend current_trace_awaiter;
-        explicit corotrace(const env::inplace_trace_entry* entry) {
-            while (entry != nullptr) {
-                entries.emplace_back(entry->loc);
-                entry = entry->prev;
+        std::vector<corotrace_entry> entries;
+    };
+
+    // Fixed capacity corotrace keeping the innermost N frames, without allocation.
+    // Source locations have static storage, so the trace stays valid after the frames are gone.
+    template<std::size_t N>
+    class inline_corotrace
+    {
+    public:
+        constexpr inline_corotrace() = default;
+
+        constexpr explicit inline_corotrace(corotrace_view view) noexcept {
+            for (const corotrace_entry_view entry : view) {
+                if (count == N) {
+                    is_truncated = true;
+                    break;
+                }
+                entries[count++] = entry.location();
             }
         }
 
-        std::vector<corotrace_entry> entries;
+        // co_await the result of this function to get the current corotrace
+        static constexpr details::current_trace_awaiter<inline_corotrace> current() noexcept { return {}; }
+
+        class iterator
+        {
+        public:
+            using value_type = corotrace_entry_view;
+            using difference_type = std::ptrdiff_t;
+
+            constexpr iterator() = default;
+
+            constexpr value_type operator*() const noexcept { return value_type(*loc); }
+
+            constexpr iterator& operator++() noexcept {
+                ++loc;
+                return *this;
+            }
+
+            constexpr iterator operator++(int) noexcept {
+                iterator old = *this;
+                ++*this;
+                return old;
+            }
+
+            friend constexpr bool operator==(const iterator&, const iterator&) = default;
+
+        private:
+            friend inline_corotrace;
+            constexpr explicit iterator(const std::source_location* loc) noexcept : loc(loc) {}
+
+            const std::source_location* loc = nullptr;
+        };
+
+        constexpr iterator begin() const noexcept { return iterator(entries.data()); }
+        constexpr iterator end() const noexcept { return iterator(entries.data() + count); }
+        constexpr bool empty() const noexcept { return count == 0; }
+        constexpr std::size_t size() const noexcept { return count; }
+
+        // True if outer frames were dropped.
+        constexpr bool truncated() const noexcept { return is_truncated; }
+
+    private:
+        std::array<std::source_location, N> entries = {};
+        std::size_t count = 0;
+        bool is_truncated = false;
     };
 
 } // namespace cocoro
@@ -132,26 +389,68 @@ namespace cocoro::env {
 
     // Derive from this class to enable coroutine tracing.
     struct trace_await_base {
+#ifdef COCORO_OBSERVE_AWAITS
+        template<typename Self, typename T>
+        auto await_transform(this Self& self, T&& awaitable,
+            std::source_location loc = std::source_location::current()) {
+            self.set_suspension_point_info(std::move(loc));
+            using awaiter_type = decltype(details::get_awaiter(std::forward<T>(awaitable)));
+            return details::observed_awaiter<awaiter_type, Self>{
+                details::get_awaiter(std::forward<T>(awaitable)), self };
+        }
+#else
         template<typename Self, typename T>
         T&& await_transform(this Self& self, T&& awaitable,
             std::source_location loc = std::source_location::current()) noexcept {
             self.set_suspension_point_info(std::move(loc));
             return std::forward<T>(awaitable);
         }
+#endif
     };
 
-    class trace_env : public trace_await_base, private details::pinned
+    // Untraced awaits are still observed when something listens,
+    // recording their location is a no-op then.
+#ifdef COCORO_OBSERVE_AWAITS
+    using no_trace_await_base = trace_await_base;
+#else
+    struct no_trace_await_base {};
+#endif
+
+    class trace_env : public trace_await_base,
+#ifdef COCORO_ENABLE_COROTRACE_DUMP
+        public details::live_trace_node,
+#endif
+        private details::pinned
     {
     public:
         using srcloc = corotrace::srcloc;
 
+#ifdef COCORO_ENABLE_COROTRACE_DUMP
+        // Registered with the live frames of the thread, see cocoro/corotrace_dump.hpp.
+        trace_env() noexcept {
+            details::live_trace_list::local().link(*this);
+        }
+
+        ~trace_env() {
+            details::live_trace_list::unlink(*this);
+            if (entry.prev != nullptr) {
+                entry.prev->awaiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+#else
         trace_env() = default;
+#endif
 
         // Inherit ctor
         template<env::queryable_r<decltype(inplace_trace), const inplace_trace_entry&> OtherEnv>
         trace_env(inherit_tag, const OtherEnv& other) noexcept
             : entry{ .prev = &inplace_trace(other), .loc = {} }
-        {}
+        {
+#ifdef COCORO_ENABLE_COROTRACE_DUMP
+            entry.prev->awaiters.fetch_add(1, std::memory_order_relaxed);
+            details::live_trace_list::local().link(*this);
+#endif
+        }
 
         // Fallback inherit ctor (use default ctor)
         trace_env(inherit_tag, const auto&) noexcept : trace_env() {}
@@ -181,18 +480,46 @@ namespace cocoro::env {
      *   }
     */
 
+    // Stand-in for trace_env when tracing is compiled out, takes no space in the frame.
+    class no_trace_env : public no_trace_await_base
+    {
+    public:
+        no_trace_env() = default;
+        no_trace_env(inherit_tag, const auto&) noexcept {}
+
+        constexpr void set_suspension_point_info(std::source_location&&) noexcept {}
+
+    private:
+        // composed_environment pulls in a query from every env
+        struct no_query {};
+
+    public:
+        void query(no_query) const noexcept {}
+    };
+
+    // Define COCORO_DISABLE_TRACE to strip tracing from library coroutines:
+    // awaits no longer record their source location, frames carry no trace entry,
+    // and corotrace::current() and friends yield empty traces.
+#ifdef COCORO_DISABLE_TRACE
+    using default_trace_env = no_trace_env;
+    using default_trace_await_base = no_trace_await_base;
+#else
+    using default_trace_env = trace_env;
+    using default_trace_await_base = trace_await_base;
+#endif
+
 } // namespace cocoro::env
 
-// formatter for corotrace_entry and corotrace
-namespace std {
+// formatter for corotrace entries and traces
+namespace cocoro::details {
 
-    template<>
-    struct formatter<cocoro::corotrace_entry> {
+    // Shared by every entry type modelling corotrace_entry_like
+    struct corotrace_entry_formatter {
         std::size_t width_info = 0;
         bool enable_full_name = true;
         bool enable_dynamic_width = false;
 
-        constexpr auto parse(format_parse_context& ctx) {
+        constexpr auto parse(std::format_parse_context& ctx) {
             auto it = ctx.begin();
             const auto end = ctx.end();
 
@@ -207,7 +534,7 @@ namespace std {
             if (*it == '{') {
                 ++it;
                 if (it == end) {
-                    throw format_error("invalid format for corotrace_entry");
+                    throw std::format_error("invalid format for corotrace_entry");
                 }
                 if (*it != '}') {
                     // parse arg index
@@ -216,7 +543,7 @@ namespace std {
                         if (ch >= '0' && ch <= '9') {
                             width_info = width_info * 10 + (ch - '0');
                         } else {
-                            throw format_error("invalid format for corotrace_entry");
+                            throw std::format_error("invalid format for corotrace_entry");
                         }
                         ++it;
                     }
@@ -225,11 +552,11 @@ namespace std {
                     width_info = ctx.next_arg_id();
                 }
                 if (it == end) {
-                    throw format_error("invalid format for corotrace_entry");
+                    throw std::format_error("invalid format for corotrace_entry");
                 }
                 ++it;
                 if (it != end && *it != '}') {
-                    throw format_error("invalid format for corotrace_entry");
+                    throw std::format_error("invalid format for corotrace_entry");
                 }
                 enable_dynamic_width = true;
                 return it;
@@ -241,20 +568,20 @@ namespace std {
                 if (ch >= '0' && ch <= '9') {
                     width_info = width_info * 10 + (ch - '0');
                 } else {
-                    throw format_error("invalid format for corotrace_entry");
+                    throw std::format_error("invalid format for corotrace_entry");
                 }
                 ++it;
             }
             if (width_info < 4) {
-                throw format_error("width must be at least 4");
+                throw std::format_error("width must be at least 4");
             }
             return it;
         }
 
-        template<typename FormatContext>
-        auto format(const cocoro::corotrace_entry& entry, FormatContext& ctx) const {
+        template<corotrace_entry_like Entry, typename FormatContext>
+        auto format(const Entry& entry, FormatContext& ctx) const {
             if (enable_full_name) {
-                return format_to(ctx.out(), "{} at {}:{}:{}",
+                return std::format_to(ctx.out(), "{} at {}:{}:{}",
                     entry.coroutine_name(),
                     entry.source_file(),
                     entry.source_line(),
@@ -267,13 +594,13 @@ namespace std {
                     []<typename T>(const T& value) static -> std::size_t {
                         if constexpr (std::integral<T>) {
                             if (value < 4) {
-                                throw format_error("width must be at least 4");
+                                throw std::format_error("width must be at least 4");
                             } else if (value < 0) {
-                                throw format_error("width argument must be non-negative");
+                                throw std::format_error("width argument must be non-negative");
                             }
                             return static_cast<std::size_t>(value);
                         } else {
-                            throw format_error("width argument must be an integer");
+                            throw std::format_error("width argument must be an integer");
                         }
                     }
                 )
@@ -283,13 +610,13 @@ namespace std {
             const std::string_view name(entry.coroutine_name());
 
             if (name.length() <= width) {
-                out = format_to(out, "{}", name);
+                out = std::format_to(out, "{}", name);
                 std::ranges::fill_n(out, width - name.length(), ' ');
             } else {
-                out = format_to(out, "{}...", name.substr(0, width - 3));
+                out = std::format_to(out, "{}...", name.substr(0, width - 3));
             }
 
-            return format_to(out, " at {}:{}:{}",
+            return std::format_to(out, " at {}:{}:{}",
                 entry.source_file(),
                 entry.source_line(),
                 entry.source_column()
@@ -297,34 +624,56 @@ namespace std {
         }
     };
 
-    template<>
-    struct formatter<cocoro::corotrace> {
-        formatter<cocoro::corotrace_entry> entry_formatter;
+    // Shared by every range of corotrace_entry_like entries, one numbered entry per line
+    struct corotrace_formatter {
+        corotrace_entry_formatter entry_formatter;
 
-        constexpr auto parse(format_parse_context& ctx) {
+        constexpr auto parse(std::format_parse_context& ctx) {
             return entry_formatter.parse(ctx);
         }
 
-        template<typename FormatContext>
-        auto format(const cocoro::corotrace& trace, FormatContext& ctx) const {
+        template<typename Trace, typename FormatContext>
+        auto format(const Trace& trace, FormatContext& ctx) const {
             auto out = ctx.out();
-            const auto size = trace.size();
-            for (std::size_t count = 0; const cocoro::corotrace_entry& entry : trace) {
-                out = format_to(out, "#{} ", count++);
-                out = entry_formatter.format(entry, ctx);
-                if (count < size) {
+            for (std::size_t count = 0; const corotrace_entry_like auto& entry : trace) {
+                if (count != 0) {
                     *out = '\n';
                     ++out;
                 }
+                out = std::format_to(out, "#{} ", count++);
+                out = entry_formatter.format(entry, ctx);
             }
             return out;
         }
     };
 
+} // namespace cocoro::details
+
+namespace std {
+
+    template<>
+    struct formatter<cocoro::corotrace_entry> : cocoro::details::corotrace_entry_formatter {};
+
+    template<>
+    struct formatter<cocoro::corotrace_entry_view> : cocoro::details::corotrace_entry_formatter {};
+
+    template<>
+    struct formatter<cocoro::corotrace> : cocoro::details::corotrace_formatter {};
+
+    template<>
+    struct formatter<cocoro::corotrace_view> : cocoro::details::corotrace_formatter {};
+
+    template<std::size_t N>
+    struct formatter<cocoro::inline_corotrace<N>> : cocoro::details::corotrace_formatter {};
+
 } // namespace std
 
 inline std::string cocoro::corotrace_entry::description() const {
     return std::format("{}", *this);
 }
 
+inline std::string cocoro::corotrace_entry_view::description() const {
+    return std::format("{}", *this);
+}
+
 #endif // COCORO_COROTRACE_H
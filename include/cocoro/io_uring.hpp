@@ -0,0 +1,597 @@
+#pragma once
+#ifndef COCORO_IO_URING_H
+#define COCORO_IO_URING_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/timer.hpp"
+#ifdef COCORO_ENABLE_PROFILER
+#include "cocoro/profiler.hpp"
+#endif
+
+namespace cocoro::details {
+
+    [[noreturn]] inline void throw_errno(int error, const char* what) {
+        throw std::system_error(error, std::system_category(), what);
+    }
+
+    // Bare io_uring instance on top of raw syscalls, single issuer.
+    class uring : private pinned
+    {
+    public:
+        explicit uring(unsigned entries) {
+            io_uring_params params = {};
+            fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0) {
+                throw_errno(errno, "io_uring_setup");
+            }
+
+            sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mmap) {
+                sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+            }
+
+            sq_ring = map(sq_ring_size, IORING_OFF_SQ_RING);
+            cq_ring = single_mmap ? sq_ring : map(cq_ring_size, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(map(params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+            auto* sq = static_cast<std::byte*>(sq_ring);
+            sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_entries = params.sq_entries;
+            // SQEs are always consumed in ring order, so the index array is an identity mapping
+            auto* sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            for (unsigned index = 0; index < sq_entries; ++index) {
+                sq_array[index] = index;
+            }
+
+            auto* cq = static_cast<std::byte*>(cq_ring);
+            cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            local_tail = *sq_tail;
+        }
+
+        ~uring() {
+            ::munmap(sqes, sqes_size);
+            if (cq_ring != sq_ring) {
+                ::munmap(cq_ring, cq_ring_size);
+            }
+            ::munmap(sq_ring, sq_ring_size);
+            ::close(fd);
+        }
+
+        // Next free SQE, nullptr if the submission queue is full.
+        io_uring_sqe* get_sqe() noexcept {
+            const unsigned head = std::atomic_ref(*sq_head).load(std::memory_order_acquire);
+            if (local_tail - head >= sq_entries) {
+                return nullptr;
+            }
+            return &sqes[local_tail++ & sq_mask];
+        }
+
+        unsigned pending() const noexcept { return local_tail - submitted_tail; }
+
+        // Submit everything queued since last call, optionally waiting for a completion
+        // at most `timeout` long.
+        void submit(unsigned wait_for, const __kernel_timespec* timeout = nullptr) {
+            std::atomic_ref(*sq_tail).store(local_tail, std::memory_order_release);
+            const unsigned count = pending();
+            unsigned flags = wait_for != 0 ? IORING_ENTER_GETEVENTS : 0;
+            if (count == 0 && wait_for == 0) {
+                return;
+            }
+            io_uring_getevents_arg arg = {};
+            const void* extra = nullptr;
+            std::size_t extra_size = 0;
+            if (wait_for != 0 && timeout != nullptr) {
+                arg.ts = reinterpret_cast<std::uintptr_t>(timeout);
+                flags |= IORING_ENTER_EXT_ARG;
+                extra = &arg;
+                extra_size = sizeof(arg);
+            }
+            const long done = ::syscall(__NR_io_uring_enter, fd, count, wait_for, flags, extra, extra_size);
+            if (done < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY || errno == ETIME) {
+                    return; // completions are reaped and submission retried next round
+                }
+                throw_errno(errno, "io_uring_enter");
+            }
+            submitted_tail += static_cast<unsigned>(done);
+        }
+
+        template<typename Fn>
+        void reap(Fn&& fn) {
+            unsigned head = *cq_head;
+            const unsigned tail = std::atomic_ref(*cq_tail).load(std::memory_order_acquire);
+            for (; head != tail; ++head) {
+                const io_uring_cqe cqe = cqes[head & cq_mask];
+                // release the slot before running the completion, which may submit more
+                std::atomic_ref(*cq_head).store(head + 1, std::memory_order_release);
+                fn(cqe);
+            }
+        }
+
+        void register_resource(unsigned opcode, const void* args, unsigned count) {
+            if (::syscall(__NR_io_uring_register, fd, opcode, args, count) < 0) {
+                throw_errno(errno, "io_uring_register");
+            }
+        }
+
+    private:
+        void* map(std::size_t size, off_t offset) {
+            void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            if (p == MAP_FAILED) {
+                throw_errno(errno, "io_uring mmap");
+            }
+            return p;
+        }
+
+        int fd = -1;
+        void* sq_ring = nullptr;
+        void* cq_ring = nullptr;
+        std::size_t sq_ring_size = 0;
+        std::size_t cq_ring_size = 0;
+        std::size_t sqes_size = 0;
+
+        unsigned* sq_head = nullptr;
+        unsigned* sq_tail = nullptr;
+        unsigned sq_mask = 0;
+        unsigned sq_entries = 0;
+        io_uring_sqe* sqes = nullptr;
+        unsigned local_tail = 0;
+        unsigned submitted_tail = 0;
+
+        unsigned* cq_head = nullptr;
+        unsigned* cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe* cqes = nullptr;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    class io_uring_context;
+
+    // Index into the files registered with io_uring_context::register_files.
+    struct fixed_file {
+        int index;
+    };
+
+    namespace details {
+
+        // Common part of I/O awaiters. The awaiter itself is the SQE user_data,
+        // so the completion reaches the awaiting coroutine without any allocation.
+        class uring_operation : private pinned
+        {
+        public:
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle);
+
+        protected:
+            uring_operation(io_uring_context& context, std::uint8_t opcode, int fd) noexcept :
+                context(context)
+            {
+                sqe.opcode = opcode;
+                sqe.fd = fd;
+            }
+
+            uring_operation(io_uring_context& context, std::uint8_t opcode, fixed_file file) noexcept :
+                uring_operation(context, opcode, file.index)
+            {
+                sqe.flags |= IOSQE_FIXED_FILE;
+            }
+
+            int checked_result(const char* what) const {
+                if (result < 0) {
+                    throw_errno(-result, what);
+                }
+                return result;
+            }
+
+            io_uring_sqe sqe = {};
+            int result = 0;
+
+        private:
+            friend io_uring_context;
+
+            io_uring_context& context;
+            std::coroutine_handle<> handle = nullptr;
+            uring_operation* next = nullptr; // pending list of foreign threads, or deferred list
+        };
+
+        class [[nodiscard]] uring_transfer : public uring_operation
+        {
+        public:
+            template<typename File>
+            uring_transfer(io_uring_context& context, std::uint8_t opcode, File file,
+                const void* buffer, std::size_t size, std::uint64_t offset, int buffer_index = -1) noexcept :
+                uring_operation(context, opcode, file)
+            {
+                sqe.addr = reinterpret_cast<std::uintptr_t>(buffer);
+                sqe.len = static_cast<std::uint32_t>(size);
+                sqe.off = offset;
+                if (buffer_index >= 0) {
+                    sqe.buf_index = static_cast<std::uint16_t>(buffer_index);
+                }
+            }
+
+            // bytes transferred
+            std::size_t await_resume() const {
+                return static_cast<std::size_t>(checked_result("io_uring transfer"));
+            }
+        };
+
+        class [[nodiscard]] uring_accept : public uring_operation
+        {
+        public:
+            template<typename File>
+            uring_accept(io_uring_context& context, File file, sockaddr* addr, socklen_t* addrlen) noexcept :
+                uring_operation(context, IORING_OP_ACCEPT, file)
+            {
+                sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+                sqe.addr2 = reinterpret_cast<std::uintptr_t>(addrlen);
+                sqe.accept_flags = SOCK_CLOEXEC;
+            }
+
+            // accepted socket
+            int await_resume() const { return checked_result("io_uring accept"); }
+        };
+
+        class [[nodiscard]] uring_connect : public uring_operation
+        {
+        public:
+            template<typename File>
+            uring_connect(io_uring_context& context, File file, const sockaddr* addr, socklen_t addrlen) noexcept :
+                uring_operation(context, IORING_OP_CONNECT, file)
+            {
+                sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+                sqe.off = addrlen;
+            }
+
+            void await_resume() const { checked_result("io_uring connect"); }
+        };
+
+        class [[nodiscard]] uring_timeout : public uring_operation
+        {
+        public:
+            uring_timeout(io_uring_context& context, std::chrono::nanoseconds duration) noexcept :
+                uring_operation(context, IORING_OP_TIMEOUT, -1)
+            {
+                const auto secs = std::chrono::duration_cast<std::chrono::seconds>(duration);
+                spec.tv_sec = secs.count();
+                spec.tv_nsec = (duration - secs).count();
+                sqe.addr = reinterpret_cast<std::uintptr_t>(&spec);
+                sqe.len = 1;
+            }
+
+            void await_resume() const {
+                if (result != -ETIME) {
+                    checked_result("io_uring timeout");
+                }
+            }
+
+        private:
+            __kernel_timespec spec = {};
+        };
+
+    } // namespace details
+
+    // Single threaded I/O reactor and scheduler driven by io_uring.
+    // run() drives the loop on the calling thread: it resumes posted coroutines,
+    // submits all SQEs queued meanwhile with a single io_uring_enter, then reaps completions.
+    // I/O operations may be awaited from any thread; those awaited off the loop thread
+    // are handed over and submitted by the loop.
+    // The context owns a timer wheel, so sleep_for / sleep_until work on the loop thread.
+    // Operations still in flight when the context is destroyed never complete.
+    class io_uring_context : private details::pinned
+    {
+    public:
+        explicit io_uring_context(unsigned entries = 256) :
+            ring(entries),
+            wake_fd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+            self_ref(*this),
+            timers(self_ref)
+        {
+            if (wake_fd < 0) {
+                details::throw_errno(errno, "eventfd");
+            }
+        }
+
+        ~io_uring_context() { ::close(wake_fd); }
+
+        void post(std::coroutine_handle<> handle) noexcept {
+            if (on_loop_thread()) {
+                ready.push_back(handle);
+                return;
+            }
+            {
+                std::scoped_lock lock(remote_mutex);
+                remote_ready.push_back(handle);
+            }
+            wake();
+        }
+
+        // Posts all of `handles` under one lock, with a single eventfd write from other threads.
+        void post_batch(std::span<const std::coroutine_handle<>> handles) noexcept {
+            if (handles.empty()) {
+                return;
+            }
+            if (on_loop_thread()) {
+                ready.insert(ready.end(), handles.begin(), handles.end());
+                return;
+            }
+            {
+                std::scoped_lock lock(remote_mutex);
+                remote_ready.insert(remote_ready.end(), handles.begin(), handles.end());
+            }
+            wake();
+        }
+
+        // co_await the result of this function to continue on the loop thread
+        scheduler_ref::schedule_awaiter schedule() const noexcept { return self_ref.schedule(); }
+
+        const scheduler_ref& query(decltype(env::get_scheduler)) const noexcept { return self_ref; }
+
+        void run() {
+            running = this;
+            scheduler_scope scope(self_ref);
+            timer_wheel::scope timer_scope(timers);
+#ifdef COCORO_ENABLE_PROFILER
+            profiler_thread_scope profiled;
+#endif
+            while (!stopping.load(std::memory_order_acquire)) {
+                arm_wake();
+                take_remote();
+                submit_deferred();
+                for (std::size_t count = ready.size(); count != 0; --count) {
+                    std::coroutine_handle<> handle = ready.front();
+                    ready.pop_front();
+                    handle.resume();
+                }
+                // after the ready queue, so that cancellations it made are settled before waiting
+                timers.advance();
+                submit_and_wait();
+                ring.reap([this](const io_uring_cqe& cqe) { complete(cqe); });
+            }
+            stopping.store(false, std::memory_order_relaxed);
+            running = nullptr;
+        }
+
+        // Make run() return after its current iteration, callable from any thread.
+        void stop() noexcept {
+            stopping.store(true, std::memory_order_release);
+            wake();
+        }
+
+        // Buffers and files must be registered before run() or from the loop thread.
+        void register_buffers(std::span<const iovec> buffers) {
+            ring.register_resource(IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size()));
+        }
+
+        void register_files(std::span<const int> fds) {
+            ring.register_resource(IORING_REGISTER_FILES, fds.data(), static_cast<unsigned>(fds.size()));
+        }
+
+        // File may be a descriptor or a fixed_file, offset -1 reads at the current file position.
+        template<typename File>
+        details::uring_transfer read(File file, std::span<std::byte> buffer, std::uint64_t offset = -1) noexcept {
+            return details::uring_transfer(*this, IORING_OP_READ, file, buffer.data(), buffer.size(), offset);
+        }
+
+        template<typename File>
+        details::uring_transfer write(File file, std::span<const std::byte> buffer, std::uint64_t offset = -1) noexcept {
+            return details::uring_transfer(*this, IORING_OP_WRITE, file, buffer.data(), buffer.size(), offset);
+        }
+
+        // buffer must lie within the registered buffer `buffer_index`
+        template<typename File>
+        details::uring_transfer read_fixed(File file, std::span<std::byte> buffer, int buffer_index, std::uint64_t offset = -1) noexcept {
+            return details::uring_transfer(*this, IORING_OP_READ_FIXED, file, buffer.data(), buffer.size(), offset, buffer_index);
+        }
+
+        template<typename File>
+        details::uring_transfer write_fixed(File file, std::span<const std::byte> buffer, int buffer_index, std::uint64_t offset = -1) noexcept {
+            return details::uring_transfer(*this, IORING_OP_WRITE_FIXED, file, buffer.data(), buffer.size(), offset, buffer_index);
+        }
+
+        template<typename File>
+        details::uring_accept accept(File file, sockaddr* addr = nullptr, socklen_t* addrlen = nullptr) noexcept {
+            return details::uring_accept(*this, file, addr, addrlen);
+        }
+
+        template<typename File>
+        details::uring_connect connect(File file, const sockaddr* addr, socklen_t addrlen) noexcept {
+            return details::uring_connect(*this, file, addr, addrlen);
+        }
+
+        details::uring_timeout timeout(std::chrono::nanoseconds duration) noexcept {
+            return details::uring_timeout(*this, duration);
+        }
+
+    private:
+        friend details::uring_operation;
+
+        static inline thread_local io_uring_context* running = nullptr;
+
+        bool on_loop_thread() const noexcept { return running == this; }
+
+        void enqueue(details::uring_operation& op) {
+            if (!on_loop_thread()) {
+                {
+                    std::scoped_lock lock(remote_mutex);
+                    op.next = std::exchange(remote_ops, &op);
+                }
+                wake();
+                return;
+            }
+            // keep submission order behind operations deferred earlier
+            if (deferred_head != nullptr || !prepare(op)) {
+                op.next = nullptr;
+                (deferred_head != nullptr ? deferred_tail->next : deferred_head) = &op;
+                deferred_tail = &op;
+            }
+        }
+
+        // Free SQE, flushing the submission queue once when it is full.
+        // nullptr while the kernel refuses submissions, e.g. EBUSY with the completion queue full,
+        // until completions are reaped.
+        io_uring_sqe* next_sqe() {
+            io_uring_sqe* sqe = ring.get_sqe();
+            if (sqe == nullptr) {
+                ring.submit(0);
+                sqe = ring.get_sqe();
+            }
+            return sqe;
+        }
+
+        bool prepare(details::uring_operation& op) {
+            io_uring_sqe* sqe = next_sqe();
+            if (sqe == nullptr) {
+                return false;
+            }
+            *sqe = op.sqe;
+            sqe->user_data = reinterpret_cast<std::uintptr_t>(&op);
+            return true;
+        }
+
+        // Operations deferred on a full submission queue, retried once per round after reaping.
+        void submit_deferred() {
+            while (deferred_head != nullptr && prepare(*deferred_head)) {
+                deferred_head = deferred_head->next;
+            }
+        }
+
+        // Block for completions only when nothing is ready, and not past the next timer.
+        // Without the wake read armed, wake() would not end the wait, so do not block.
+        void submit_and_wait() {
+            if (!ready.empty() || !wake_armed) {
+                ring.submit(0);
+                return;
+            }
+            const std::optional<timer_wheel::duration> next = timers.next_timeout();
+            if (!next) {
+                ring.submit(1);
+                return;
+            }
+            const auto secs = std::chrono::duration_cast<std::chrono::seconds>(*next);
+            const __kernel_timespec spec = {
+                .tv_sec = secs.count(),
+                .tv_nsec = std::chrono::nanoseconds(*next - secs).count(),
+            };
+            ring.submit(1, &spec);
+        }
+
+        void complete(const io_uring_cqe& cqe) {
+            if (cqe.user_data == wake_tag) {
+                wake_pending.store(false, std::memory_order_release);
+                wake_armed = false;
+                arm_wake();
+                return;
+            }
+            auto* op = reinterpret_cast<details::uring_operation*>(cqe.user_data);
+            op->result = cqe.res;
+            op->handle.resume();
+        }
+
+        void take_remote() {
+            details::uring_operation* ops = nullptr;
+            {
+                std::scoped_lock lock(remote_mutex);
+                ops = std::exchange(remote_ops, nullptr);
+                for (std::coroutine_handle<> handle : remote_ready) {
+                    ready.push_back(handle);
+                }
+                remote_ready.clear();
+            }
+            while (ops != nullptr) {
+                enqueue(*std::exchange(ops, ops->next));
+            }
+        }
+
+        // At most one wake read is in flight, it stays armed across run() calls.
+        void arm_wake() {
+            if (wake_armed) {
+                return;
+            }
+            io_uring_sqe* sqe = next_sqe();
+            if (sqe == nullptr) {
+                return; // armed next round
+            }
+            wake_armed = true;
+            *sqe = {};
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = wake_fd;
+            sqe->addr = reinterpret_cast<std::uintptr_t>(&wake_buffer);
+            sqe->len = sizeof(wake_buffer);
+            sqe->user_data = wake_tag;
+        }
+
+        void wake() noexcept {
+            if (!wake_pending.exchange(true, std::memory_order_acq_rel)) {
+                const std::uint64_t one = 1;
+                [[maybe_unused]] const auto written = ::write(wake_fd, &one, sizeof(one));
+            }
+        }
+
+        static constexpr std::uint64_t wake_tag = 1; // never a valid awaiter address
+
+        details::uring ring;
+        int wake_fd;
+        std::uint64_t wake_buffer = 0;
+        std::atomic<bool> wake_pending = false;
+        bool wake_armed = false;
+        std::atomic<bool> stopping = false;
+        scheduler_ref self_ref;
+        timer_wheel timers;
+
+        std::deque<std::coroutine_handle<>> ready;
+
+        std::mutex remote_mutex;
+        std::vector<std::coroutine_handle<>> remote_ready;
+        details::uring_operation* remote_ops = nullptr;
+
+        details::uring_operation* deferred_head = nullptr;
+        details::uring_operation* deferred_tail = nullptr;
+    };
+
+    inline void details::uring_operation::await_suspend(std::coroutine_handle<> handle) {
+        this->handle = handle;
+        context.enqueue(*this);
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_IO_URING_H
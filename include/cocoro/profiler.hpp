@@ -0,0 +1,347 @@
+#pragma once
+#ifndef COCORO_PROFILER_H
+#define COCORO_PROFILER_H 1
+
+#ifndef COCORO_ENABLE_PROFILER
+#error "cocoro/profiler.hpp needs COCORO_ENABLE_PROFILER, see the profiler option in xmake.lua"
+#endif
+
+#ifdef COCORO_DISABLE_TRACE
+#error "the sampling profiler walks corotrace chains, it cannot be used with COCORO_DISABLE_TRACE"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <stop_token>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/trace.hpp"
+#include "cocoro/env/active_trace.hpp"
+
+namespace cocoro::details {
+
+    // Deeper chains keep their innermost frames.
+    inline constexpr std::size_t profile_max_depth = 32;
+
+    struct profile_sample {
+        std::uint32_t depth = 0;
+        bool truncated = false;
+        std::array<std::source_location, profile_max_depth> frames; // innermost first
+    };
+
+    // Samples of one thread, written by the signal handler on that thread
+    // and drained under the registry lock, periodically by the profiler's drain thread.
+    class profile_buffer : private pinned
+    {
+    public:
+        static constexpr std::size_t capacity = 512;
+
+        // async signal safe
+        bool record(const env::inplace_trace_entry* entry) noexcept {
+            const std::size_t tail = this->tail.load(std::memory_order_relaxed);
+            if (tail - head.load(std::memory_order_acquire) == capacity) {
+                return false;
+            }
+            profile_sample& sample = samples[tail % capacity];
+            std::uint32_t depth = 0;
+            for (; entry != nullptr && depth < profile_max_depth; entry = entry->prev) {
+                sample.frames[depth++] = entry->loc; // copies a pointer to static data
+            }
+            sample.depth = depth;
+            sample.truncated = entry != nullptr;
+            this->tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        template<typename Fn>
+        void drain(Fn&& fn) {
+            std::size_t head = this->head.load(std::memory_order_relaxed);
+            const std::size_t tail = this->tail.load(std::memory_order_acquire);
+            for (; head != tail; ++head) {
+                std::invoke(fn, std::as_const(samples[head % capacity]));
+            }
+            this->head.store(head, std::memory_order_release);
+        }
+
+    private:
+        std::array<profile_sample, capacity> samples;
+        std::atomic<std::size_t> head = 0;
+        std::atomic<std::size_t> tail = 0;
+    };
+
+    // Stacks are keyed by the static data of their source locations, never by their text.
+    struct profile_stack {
+        std::vector<std::source_location> frames; // innermost first
+        bool truncated = false;
+
+        friend bool operator==(const profile_stack& lhs, const profile_stack& rhs) noexcept {
+            return lhs.truncated == rhs.truncated && std::ranges::equal(lhs.frames, rhs.frames, same_site);
+        }
+
+        static bool same_site(const std::source_location& lhs, const std::source_location& rhs) noexcept {
+            return lhs.function_name() == rhs.function_name() && lhs.file_name() == rhs.file_name()
+                && lhs.line() == rhs.line() && lhs.column() == rhs.column();
+        }
+    };
+
+    struct profile_stack_hash {
+        std::size_t operator()(const profile_stack& stack) const noexcept {
+            std::size_t hash = stack.truncated;
+            for (const std::source_location& loc : stack.frames) {
+                hash = hash * 31 + std::hash<const char*>{}(loc.function_name());
+                hash = hash * 31 + loc.line();
+            }
+            return hash;
+        }
+    };
+
+    // Per thread buffers and the stacks aggregated from them.
+    class profile_registry : private pinned
+    {
+    public:
+        static profile_registry& instance() noexcept {
+            static profile_registry registry;
+            return registry;
+        }
+
+        void attach(profile_buffer& buffer) {
+            std::scoped_lock lock(mutex);
+            buffers.push_back(&buffer);
+        }
+
+        void detach(profile_buffer& buffer) {
+            std::scoped_lock lock(mutex);
+            drain(buffer);
+            std::erase(buffers, &buffer);
+        }
+
+        // Moves the samples of every buffer into the aggregated stacks.
+        void drain_all() {
+            std::scoped_lock lock(mutex);
+            for (profile_buffer* buffer : buffers) {
+                drain(*buffer);
+            }
+        }
+
+        template<typename Fn>
+        void for_each_stack(Fn&& fn) {
+            std::scoped_lock lock(mutex);
+            for (profile_buffer* buffer : buffers) {
+                drain(*buffer);
+            }
+            for (const auto& [stack, count] : stacks) {
+                std::invoke(fn, stack, count);
+            }
+        }
+
+        void clear() {
+            std::scoped_lock lock(mutex);
+            for (profile_buffer* buffer : buffers) {
+                buffer->drain([](const profile_sample&) {});
+            }
+            stacks.clear();
+        }
+
+    private:
+        profile_registry() = default;
+
+        void drain(profile_buffer& buffer) {
+            buffer.drain([this](const profile_sample& sample) {
+                profile_stack stack{ { sample.frames.begin(), sample.frames.begin() + sample.depth }, sample.truncated };
+                ++stacks[std::move(stack)];
+            });
+        }
+
+        std::mutex mutex;
+        std::vector<profile_buffer*> buffers;
+        std::unordered_map<profile_stack, std::size_t, profile_stack_hash> stacks;
+    };
+
+    inline thread_local constinit profile_buffer* current_profile_buffer = nullptr;
+    inline std::atomic<std::size_t> profile_dropped = 0;
+
+    inline void profile_signal_handler(int) noexcept {
+        const int saved_errno = errno;
+        if (profile_buffer* buffer = current_profile_buffer; buffer != nullptr) {
+            if (!buffer->record(active_trace.load(std::memory_order_relaxed))) {
+                profile_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        errno = saved_errno;
+    }
+
+    inline std::atomic<bool> profiler_running = false;
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Makes the calling thread visible to the sampling profiler while alive.
+    // Thread pool workers and io_uring loops hold one in profiler builds,
+    // other threads running coroutines may hold their own.
+    class profiler_thread_scope : private details::pinned
+    {
+    public:
+        profiler_thread_scope() :
+            buffer(std::make_unique<details::profile_buffer>()),
+            prev(details::current_profile_buffer)
+        {
+            details::profile_registry::instance().attach(*buffer);
+            details::current_profile_buffer = buffer.get();
+        }
+
+        ~profiler_thread_scope() {
+            details::current_profile_buffer = prev;
+            std::atomic_signal_fence(std::memory_order_seq_cst); // handler no longer sees the buffer
+            details::profile_registry::instance().detach(*buffer);
+        }
+
+    private:
+        std::unique_ptr<details::profile_buffer> buffer;
+        details::profile_buffer* prev;
+    };
+
+    // Samples the coroutine running on each registered thread every `interval` of CPU time
+    // (ITIMER_PROF, SIGPROF delivered to the running thread) and walks its trace chain.
+    // Sampling copies the source locations of the chain into a per thread buffer and nothing else;
+    // stacks are aggregated by a drain thread the profiler owns, a quarter of a buffer's worth
+    // of samples apart, and named only when read back through folded().
+    // One profiler runs at a time, samples outlive it until clear().
+    class sampling_profiler : private details::pinned
+    {
+    public:
+        explicit sampling_profiler(std::chrono::microseconds interval = std::chrono::milliseconds(1)) {
+            if (details::profiler_running.exchange(true, std::memory_order_acq_rel)) {
+                throw std::logic_error("cocoro: a sampling profiler is already running");
+            }
+            // joined by its destructor should the profiler fail to start
+            try {
+                const auto period = interval * (details::profile_buffer::capacity / 4);
+                drainer = std::jthread([period](std::stop_token stop) { drain_loop(stop, period); });
+            } catch (...) {
+                details::profiler_running.store(false, std::memory_order_release);
+                throw;
+            }
+            struct sigaction action = {};
+            action.sa_handler = &details::profile_signal_handler;
+            action.sa_flags = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            if (sigaction(SIGPROF, &action, &old_action) != 0) {
+                details::profiler_running.store(false, std::memory_order_release);
+                throw std::system_error(errno, std::system_category(), "sigaction");
+            }
+            const timeval period = {
+                .tv_sec = static_cast<time_t>(interval.count() / 1'000'000),
+                .tv_usec = static_cast<suseconds_t>(interval.count() % 1'000'000),
+            };
+            const itimerval timer = { .it_interval = period, .it_value = period };
+            if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+                const int error = errno;
+                sigaction(SIGPROF, &old_action, nullptr);
+                details::profiler_running.store(false, std::memory_order_release);
+                throw std::system_error(error, std::system_category(), "setitimer");
+            }
+        }
+
+        ~sampling_profiler() {
+            const itimerval disarmed = {};
+            setitimer(ITIMER_PROF, &disarmed, nullptr);
+            sigaction(SIGPROF, &old_action, nullptr);
+            drainer.request_stop();
+            drainer.join();
+            details::profiler_running.store(false, std::memory_order_release);
+        }
+
+        // Aggregated samples in the folded stack format of flamegraph.pl and friends,
+        // one `outermost;...;innermost count` line per distinct stack.
+        // Frames read `function file:line`, at the suspension point recorded for the frame;
+        // samples taken outside any coroutine fold into "[no coroutine]".
+        static std::string folded() {
+            std::string result;
+            details::profile_registry::instance().for_each_stack(
+                [&](const details::profile_stack& stack, std::size_t count) {
+                    if (stack.truncated) {
+                        result += "[truncated];";
+                    }
+                    if (stack.frames.empty()) {
+                        result += "[no coroutine]";
+                    }
+                    bool first = true;
+                    for (auto it = stack.frames.rbegin(); it != stack.frames.rend(); ++it) {
+                        if (*it->function_name() == '\0') {
+                            continue; // never awaited anything, e.g. when_all children
+                        }
+                        if (!std::exchange(first, false)) {
+                            result += ';';
+                        }
+                        append_frame(result, *it);
+                    }
+                    std::format_to(std::back_inserter(result), " {}\n", count);
+                });
+            return result;
+        }
+
+        // Samples lost to full buffers, sample less often if not zero.
+        static std::size_t dropped() noexcept {
+            return details::profile_dropped.load(std::memory_order_relaxed);
+        }
+
+        static void clear() {
+            details::profile_registry::instance().clear();
+            details::profile_dropped.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static void drain_loop(std::stop_token stop, std::chrono::microseconds period) {
+            // samples belong to the threads running coroutines, not to this one
+            sigset_t profiled;
+            sigemptyset(&profiled);
+            sigaddset(&profiled, SIGPROF);
+            pthread_sigmask(SIG_BLOCK, &profiled, nullptr);
+            std::mutex mutex;
+            std::condition_variable_any wakeup;
+            std::unique_lock lock(mutex);
+            while (!stop.stop_requested()) {
+                wakeup.wait_for(lock, stop, period, [] { return false; });
+                details::profile_registry::instance().drain_all();
+            }
+        }
+
+        // ';' separates frames
+        static void append_frame(std::string& out, const std::source_location& loc) {
+            const std::size_t start = out.size();
+            std::format_to(std::back_inserter(out), "{} {}:{}", loc.function_name(), loc.file_name(), loc.line());
+            std::ranges::replace(out.begin() + start, out.end(), ';', ',');
+        }
+
+        struct sigaction old_action = {};
+        std::jthread drainer;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_PROFILER_H
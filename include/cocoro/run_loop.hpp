@@ -0,0 +1,181 @@
+#pragma once
+#ifndef COCORO_RUN_LOOP_H
+#define COCORO_RUN_LOOP_H 1
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/timer.hpp"
+#ifdef COCORO_ENABLE_PROFILER
+#include "cocoro/profiler.hpp"
+#endif
+
+namespace cocoro {
+
+    // Single threaded scheduler driven by whichever thread calls run().
+    // run() resumes posted coroutines and fires due timers on the calling thread,
+    // and parks only while nothing is queued, until the next timer at the latest.
+    // Coroutines may be posted from any thread. The loop owns a timer wheel,
+    // so sleep_for / sleep_until work on the loop thread.
+    // Coroutines still queued when run() returns stay queued for the next run() or drain().
+    class run_loop : private details::pinned
+    {
+    public:
+        run_loop() noexcept :
+            self_ref(*this),
+            timers(self_ref)
+        {}
+
+        void post(std::coroutine_handle<> handle) noexcept {
+            if (on_loop_thread()) {
+                ready.push_back(handle);
+                return;
+            }
+            {
+                std::scoped_lock lock(remote_mutex);
+                remote_ready.push_back(handle);
+            }
+            wakeup.notify_one();
+        }
+
+        void post_batch(std::span<const std::coroutine_handle<>> handles) noexcept {
+            if (handles.empty()) {
+                return;
+            }
+            if (on_loop_thread()) {
+                ready.insert(ready.end(), handles.begin(), handles.end());
+                return;
+            }
+            {
+                std::scoped_lock lock(remote_mutex);
+                remote_ready.insert(remote_ready.end(), handles.begin(), handles.end());
+            }
+            wakeup.notify_one();
+        }
+
+        // co_await the result of this function to continue on the loop thread
+        scheduler_ref::schedule_awaiter schedule() const noexcept { return self_ref.schedule(); }
+
+        const scheduler_ref& query(decltype(env::get_scheduler)) const noexcept { return self_ref; }
+
+        void run() {
+            driving_scope driving(*this);
+            while (!stopping.load(std::memory_order_acquire)) {
+                take_remote();
+                resume_ready();
+                timers.advance();
+                if (ready.empty()) {
+                    park();
+                }
+            }
+            stopping.store(false, std::memory_order_relaxed);
+        }
+
+        // Resumes queued coroutines and due timers, and whatever they queue in turn,
+        // until nothing is ready. Never parks, so timers not yet due stay armed.
+        void drain() {
+            driving_scope driving(*this);
+            while (true) {
+                timers.advance();
+                take_remote();
+                if (ready.empty()) {
+                    break;
+                }
+                resume_ready();
+            }
+        }
+
+        // Make run() return after its current iteration, callable from any thread.
+        void stop() noexcept {
+            {
+                // under the lock, so that a parking loop cannot miss it
+                std::scoped_lock lock(remote_mutex);
+                stopping.store(true, std::memory_order_release);
+            }
+            wakeup.notify_one();
+        }
+
+        // Whether the calling thread is running some run_loop.
+        static bool running_on_this_thread() noexcept { return running != nullptr; }
+
+    private:
+        static inline thread_local run_loop* running = nullptr;
+
+        // run() may unwind with an exception from a resumed coroutine
+        class running_scope : private details::pinned
+        {
+        public:
+            explicit running_scope(run_loop& loop) noexcept : prev(std::exchange(running, &loop)) {}
+            ~running_scope() { running = prev; }
+
+        private:
+            run_loop* prev;
+        };
+
+        // The calling thread drives the loop while alive.
+        class driving_scope : private details::pinned
+        {
+        public:
+            explicit driving_scope(run_loop& loop) : running_guard(loop), scope(loop.self_ref), timer_scope(loop.timers) {}
+
+        private:
+            running_scope running_guard;
+            scheduler_scope scope;
+            timer_wheel::scope timer_scope;
+#ifdef COCORO_ENABLE_PROFILER
+            profiler_thread_scope profiled;
+#endif
+        };
+
+        bool on_loop_thread() const noexcept { return running == this; }
+
+        void resume_ready() {
+            for (std::size_t count = ready.size(); count != 0; --count) {
+                std::coroutine_handle<> handle = ready.front();
+                ready.pop_front();
+                handle.resume();
+            }
+        }
+
+        void take_remote() {
+            std::scoped_lock lock(remote_mutex);
+            ready.insert(ready.end(), remote_ready.begin(), remote_ready.end());
+            remote_ready.clear();
+        }
+
+        void park() {
+            std::unique_lock lock(remote_mutex);
+            const auto has_work = [this] {
+                return !remote_ready.empty() || stopping.load(std::memory_order_relaxed);
+            };
+            if (const std::optional<timer_wheel::duration> next = timers.next_timeout()) {
+                wakeup.wait_for(lock, *next, has_work);
+            } else {
+                wakeup.wait(lock, has_work);
+            }
+        }
+
+        std::atomic<bool> stopping = false;
+        scheduler_ref self_ref;
+        timer_wheel timers;
+
+        std::deque<std::coroutine_handle<>> ready;
+
+        std::mutex remote_mutex;
+        std::condition_variable wakeup;
+        std::vector<std::coroutine_handle<>> remote_ready;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_RUN_LOOP_H
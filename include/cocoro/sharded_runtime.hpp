@@ -0,0 +1,327 @@
+#pragma once
+#ifndef COCORO_SHARDED_RUNTIME_H
+#define COCORO_SHARDED_RUNTIME_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/futex.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/task.hpp"
+#include "cocoro/timer.hpp"
+#ifdef COCORO_ENABLE_PROFILER
+#include "cocoro/profiler.hpp"
+#endif
+
+namespace cocoro::details {
+
+    // Bounded single producer single consumer ring of coroutine handles.
+    // Each side caches the other's index and only reloads it when the ring looks full or empty.
+    class spsc_ring : private pinned
+    {
+    public:
+        static constexpr std::size_t capacity = 256;
+
+        // producer only, false if full
+        bool try_push(std::coroutine_handle<> handle) noexcept {
+            const std::size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head_cache == capacity) {
+                head_cache = head.load(std::memory_order_acquire);
+                if (t - head_cache == capacity) {
+                    return false;
+                }
+            }
+            slots[t & mask] = handle.address();
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer only, null if empty
+        std::coroutine_handle<> try_pop() noexcept {
+            const std::size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail_cache) {
+                tail_cache = tail.load(std::memory_order_acquire);
+                if (h == tail_cache) {
+                    return nullptr;
+                }
+            }
+            void* addr = slots[h & mask];
+            head.store(h + 1, std::memory_order_release);
+            return std::coroutine_handle<>::from_address(addr);
+        }
+
+        bool empty() const noexcept {
+            return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr std::size_t mask = capacity - 1;
+
+        // consumer side
+        alignas(64) std::atomic<std::size_t> head = 0;
+        std::size_t tail_cache = 0;
+        // producer side
+        alignas(64) std::atomic<std::size_t> tail = 0;
+        std::size_t head_cache = 0;
+        alignas(64) void* slots[capacity] = {};
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Thread per core runtime: one scheduler per shard, each driven by its own thread,
+    // pinned to a core by default. Shards share no run queue. A coroutine posted by a shard
+    // to another goes through the ring dedicated to that pair of shards; posts from outside
+    // go through a locked injection queue of the target shard.
+    // Each shard is a scheduler of its own, recorded by affine_env like any other,
+    // so a task awaited on a shard completes back on it, see on_shard().
+    // Each shard owns a timer wheel and parks no longer than its next timer.
+    // Coroutines still queued or sleeping on destruction are leaked, not destroyed.
+    class sharded_runtime : private details::pinned
+    {
+    public:
+        explicit sharded_runtime(std::size_t shard_count = std::thread::hardware_concurrency(), bool pin_threads = true) :
+            shard_count(shard_count == 0 ? 1 : shard_count),
+            shards(std::make_unique<shard[]>(this->shard_count)),
+            rings(std::make_unique<details::spsc_ring[]>(this->shard_count * this->shard_count))
+        {
+            for (std::size_t index = 0; index < this->shard_count; ++index) {
+                shards[index].runtime = this;
+                shards[index].index = index;
+            }
+            threads.reserve(this->shard_count);
+            for (std::size_t index = 0; index < this->shard_count; ++index) {
+                threads.emplace_back([this, index] { run_shard(shards[index]); });
+                if (pin_threads) {
+                    pin(threads.back(), index);
+                }
+            }
+        }
+
+        ~sharded_runtime() {
+            stopping.store(true, std::memory_order_seq_cst);
+            for (std::size_t index = 0; index < shard_count; ++index) {
+                shards[index].wake();
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+        }
+
+        std::size_t size() const noexcept { return shard_count; }
+
+        // Scheduler of shard `index`.
+        const scheduler_ref& shard_scheduler(std::size_t index) const noexcept { return shards[index].self_ref; }
+
+        // co_await the result of this function to continue on shard `index`
+        scheduler_ref::schedule_awaiter schedule(std::size_t index) const noexcept {
+            return shards[index].self_ref.schedule();
+        }
+
+        // Runtime of the shard running the calling thread, null if none.
+        static sharded_runtime* current() noexcept {
+            return current_shard != nullptr ? current_shard->runtime : nullptr;
+        }
+
+        // Index of the shard running the calling thread, only meaningful if current() is not null.
+        static std::size_t current_index() noexcept {
+            return current_shard != nullptr ? current_shard->index : 0;
+        }
+
+    private:
+        class shard : private details::pinned
+        {
+        public:
+            shard() : self_ref(*this), timers(self_ref) {}
+
+            void post(std::coroutine_handle<> handle) noexcept { runtime->post_to(*this, handle); }
+
+            // After publishing work: the recheck of park() or this load sees the other side.
+            void wake() noexcept {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (sleeping.load(std::memory_order_seq_cst)) {
+                    wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+                    details::futex_wake(wake_epoch);
+                }
+            }
+
+            sharded_runtime* runtime = nullptr;
+            std::size_t index = 0;
+            scheduler_ref self_ref;
+            // owner only, cancellations from other threads are posted back
+            timer_wheel timers;
+
+            // owner only
+            std::deque<std::coroutine_handle<>> local;
+
+            std::mutex inject_mutex;
+            std::vector<std::coroutine_handle<>> injected;
+            alignas(64) std::atomic<std::size_t> injected_size = 0;
+
+            alignas(64) std::atomic<std::uint32_t> wake_epoch = 0;
+            std::atomic<bool> sleeping = false;
+        };
+
+        static inline thread_local shard* current_shard = nullptr;
+
+        // Polling rounds over empty queues before a shard parks.
+        static constexpr int spin_rounds = 64;
+
+        details::spsc_ring& ring(std::size_t from, std::size_t to) noexcept {
+            return rings[to * shard_count + from];
+        }
+
+        static void pin(std::thread& thread, std::size_t index) noexcept {
+            const unsigned cores = std::thread::hardware_concurrency();
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cores == 0 ? 0 : index % cores, &set);
+            // best effort, an unpinned shard still works
+            ::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+        }
+
+        void post_to(shard& target, std::coroutine_handle<> handle) noexcept {
+            shard* self = current_shard;
+            if (self == &target) {
+                target.local.push_back(handle);
+                return;
+            }
+            if (self == nullptr || self->runtime != this || !ring(self->index, target.index).try_push(handle)) {
+                // from outside, or the ring is full
+                std::scoped_lock lock(target.inject_mutex);
+                target.injected.push_back(handle);
+                target.injected_size.fetch_add(1, std::memory_order_seq_cst);
+            }
+            target.wake();
+        }
+
+        void run_shard(shard& self) {
+            current_shard = &self;
+            scheduler_scope scope(self.self_ref);
+            timer_wheel::scope timer_scope(self.timers);
+#ifdef COCORO_ENABLE_PROFILER
+            profiler_thread_scope profiled;
+#endif
+            std::vector<std::coroutine_handle<>> injected;
+            int idle_rounds = 0;
+            while (true) {
+                self.timers.advance();
+                if (run_once(self, injected)) {
+                    idle_rounds = 0;
+                    continue;
+                }
+                if (stopping.load(std::memory_order_acquire)) {
+                    break;
+                }
+                if (++idle_rounds < spin_rounds) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                park(self);
+                idle_rounds = 0;
+            }
+            current_shard = nullptr;
+        }
+
+        // Resumes what is queued right now, false if nothing was.
+        bool run_once(shard& self, std::vector<std::coroutine_handle<>>& injected) {
+            bool ran = false;
+            for (std::size_t from = 0; from < shard_count; ++from) {
+                details::spsc_ring& incoming = ring(from, self.index);
+                // bounded, so that one busy peer does not starve the others
+                for (std::size_t n = 0; n < details::spsc_ring::capacity; ++n) {
+                    const std::coroutine_handle<> handle = incoming.try_pop();
+                    if (handle == nullptr) {
+                        break;
+                    }
+                    handle.resume();
+                    ran = true;
+                }
+            }
+            if (self.injected_size.load(std::memory_order_relaxed) != 0) {
+                {
+                    std::scoped_lock lock(self.inject_mutex);
+                    injected.swap(self.injected);
+                    self.injected_size.store(0, std::memory_order_relaxed);
+                }
+                for (std::coroutine_handle<> handle : injected) {
+                    handle.resume();
+                }
+                ran = ran || !injected.empty();
+                injected.clear();
+            }
+            for (std::size_t count = self.local.size(); count != 0; --count) {
+                const std::coroutine_handle<> handle = self.local.front();
+                self.local.pop_front();
+                handle.resume();
+                ran = true;
+            }
+            return ran;
+        }
+
+        bool has_work(const shard& self) const noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!self.local.empty() || self.injected_size.load(std::memory_order_seq_cst) != 0) {
+                return true;
+            }
+            for (std::size_t from = 0; from < shard_count; ++from) {
+                if (!rings[self.index * shard_count + from].empty()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Futex style parking, see thread_pool::park, until the next timer at the latest.
+        void park(shard& self) noexcept {
+            const std::uint32_t epoch = self.wake_epoch.load(std::memory_order_seq_cst);
+            self.sleeping.store(true, std::memory_order_seq_cst);
+            if (!has_work(self) && !stopping.load(std::memory_order_seq_cst)) {
+                // std::atomic::wait has no timeout
+                details::futex_wait(self.wake_epoch, epoch, self.timers.next_timeout());
+            }
+            self.sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        std::size_t shard_count;
+        std::unique_ptr<shard[]> shards;
+        std::unique_ptr<details::spsc_ring[]> rings;
+        std::vector<std::thread> threads;
+        std::atomic<bool> stopping = false;
+    };
+
+    // co_await the result of this function to run `work` on shard `index` of the runtime
+    // driving the calling thread, and to get its result back on the calling shard.
+    // Throws std::logic_error when not called from a shard, or when there is no shard `index`.
+    template<typename T>
+    task<T> on_shard(std::size_t index, task<T> work) {
+        sharded_runtime* runtime = sharded_runtime::current();
+        if (runtime == nullptr) {
+            throw std::logic_error("cocoro: on_shard() called off a shard");
+        }
+        if (index >= runtime->size()) {
+            throw std::logic_error("cocoro: on_shard() index out of range");
+        }
+        if (index != sharded_runtime::current_index()) {
+            co_await runtime->schedule(index);
+        }
+        co_return co_await std::move(work);
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_SHARDED_RUNTIME_H
@@ -0,0 +1,110 @@
+#pragma once
+#ifndef COCORO_SYNC_WAIT_H
+#define COCORO_SYNC_WAIT_H 1
+
+#include <exception>
+#include <stdexcept>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/symres.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/detached_task.hpp"
+#include "cocoro/run_loop.hpp"
+#include "cocoro/task.hpp"
+
+namespace cocoro {
+
+    // Thrown by sync_wait() when the task completed through its stopped path.
+    class sync_wait_stopped : public std::exception
+    {
+    public:
+        const char* what() const noexcept override { return "cocoro: task awaited by sync_wait() was stopped"; }
+    };
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    // Run loop of the thread blocked in sync_wait(), reused across calls.
+    inline run_loop& sync_wait_loop() {
+        static thread_local run_loop loop;
+        return loop;
+    }
+
+    // Stops the loop once the driver is gone, completed or unwound by a stop.
+    struct sync_wait_finisher {
+        run_loop& loop;
+
+        ~sync_wait_finisher() { loop.stop(); }
+    };
+
+    template<typename T>
+    detached_task sync_wait_driver(task<T> work, symmetric_result<T>& result, bool& completed, run_loop& loop) {
+        const sync_wait_finisher finisher{ loop };
+        co_await loop.schedule(); // the task records the loop as its scheduler
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(work);
+                result.return_void();
+            } else {
+                result.return_value(co_await std::move(work));
+            }
+        } catch (...) {
+            result.unhandled_exception();
+        }
+        completed = true;
+    }
+
+    template<typename T>
+    T sync_wait_impl(task<T> work, const std::inplace_stop_token* token) {
+        if (this_thread::current_scheduler() != scheduler_ref{}) {
+            throw std::logic_error(run_loop::running_on_this_thread()
+                ? "cocoro: nested sync_wait() would never return"
+                : "cocoro: sync_wait() would block the scheduler driving this thread");
+        }
+        run_loop& loop = sync_wait_loop();
+        symmetric_result<T> result;
+        bool completed = false;
+        detached_task driver = sync_wait_driver(std::move(work), result, completed, loop);
+        if (token != nullptr) {
+            std::move(driver).start(*token);
+        } else {
+            std::move(driver).start();
+        }
+        loop.run();
+        loop.drain(); // nothing `work` left ready runs in a later sync_wait()
+        if (!completed) {
+            throw sync_wait_stopped();
+        }
+        return result.result();
+    }
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Blocks until `work` completes and returns its result, rethrowing its exception.
+    // The calling thread drives a thread local run_loop meanwhile: whatever `work` runs
+    // on this thread runs inline, and continuations coming back from other schedulers
+    // are resumed here without a thread hop through a pool. Coroutines left ready on the loop,
+    // e.g. spawned onto it by `work`, are run until they suspend elsewhere before it returns;
+    // only those coming back later, through timers or from other threads, wait for the next call.
+    // Must not be called from a thread driven by a scheduler, which includes
+    // nested calls from coroutines run by sync_wait(); throws std::logic_error if so.
+    template<typename T>
+    T sync_wait(task<T> work) {
+        return details::sync_wait_impl(std::move(work), nullptr);
+    }
+
+    // Same, with a stop token the task inherits; throws sync_wait_stopped if it stops.
+    template<typename T>
+    T sync_wait(task<T> work, std::inplace_stop_token token) {
+        return details::sync_wait_impl(std::move(work), &token);
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_SYNC_WAIT_H
@@ -2,12 +2,141 @@
 #ifndef COCORO_SYMMETRIC_TASK_H
 #define COCORO_SYMMETRIC_TASK_H 1
 
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <expected>
+#include <type_traits>
+#include <utility>
+
 #include "cocoro/utils/symres.hpp"
 #include "cocoro/utils/basic_promise.hpp"
+#include "cocoro/utils/frame_alloc.hpp"
 #include "cocoro/env/trace.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
 
 namespace cocoro {
 
+    // Forward declaration
+    template<typename ResultType>
+    class task;
+
+    // Forward declaration
+    template<typename ResultType>
+    class tail_call;
+
+    // Forward declaration
+    class async_scope;
+
+    namespace details {
+
+        // Forward declaration
+        template<typename T, typename E>
+        class try_awaiter;
+
+        // Forward declaration
+        template<typename State, typename T>
+        class join_child;
+
+        template<typename T>
+        inline constexpr bool is_expected_v = false;
+
+        template<typename T, typename E>
+        inline constexpr bool is_expected_v<std::expected<T, E>> = true;
+
+        // Outcome of completing one frame. An error travelling up through try_await()
+        // names the next frame to complete, so a chain of any depth unwinds in a loop
+        // (see unwind_errors) rather than one nested call per frame.
+        struct error_unwind {
+            using step_fn = error_unwind (*)(void* frame) noexcept;
+            step_fn step = nullptr; // completes `frame`, null once unwound
+            void* frame = nullptr;
+            std::coroutine_handle<> next = nullptr; // continue here once unwound
+        };
+
+        inline std::coroutine_handle<> unwind_errors(error_unwind unwind) noexcept {
+            while (unwind.step != nullptr) {
+                unwind = unwind.step(unwind.frame);
+            }
+            return unwind.next;
+        }
+
+        // Only a task<std::expected<T, E>> awaited through try_await() completes its parent
+        // on error, through the awaiter, which hands the error over and releases the task.
+        template<typename ResultType>
+        struct error_return_slot {};
+
+        template<typename T, typename E>
+        struct error_return_slot<std::expected<T, E>> {
+            try_awaiter<T, E>* error_return = nullptr;
+        };
+
+        // Result slot of a task, which may complete with the result of a tail call instead.
+        // The first task of a chain of tail calls is kept as the head, the awaiting coroutine
+        // reads the result through it. The head links to the frame now running, and every later
+        // frame links back to the head, so frames in the middle are destroyed on completion.
+        template<typename ResultType>
+        class task_result : public symmetric_result<ResultType>, public error_return_slot<ResultType>
+        {
+        public:
+            using symmetric_result<ResultType>::return_value;
+
+            void return_value(tail_call<ResultType> call) noexcept {
+                using promise_type = task<ResultType>::promise_type;
+                using handle_type = task<ResultType>::handle_type;
+                using status = symmetric_result<ResultType>::status;
+                handle_type successor = std::exchange(call.child.handle, nullptr);
+                if (this->result_state() == status::tail_link) {
+                    void* head = this->link();
+                    handle_type::from_address(head).promise().set_link(status::tail_head, successor.address());
+                    successor.promise().set_link(status::tail_link, head);
+                } else {
+                    this->set_link(status::tail_head, successor.address());
+                    successor.promise().set_link(status::tail_link,
+                        handle_type::from_promise(static_cast<promise_type&>(*this)).address());
+                }
+            }
+
+            // symmetric_result::state() is hidden by its data member
+            symmetric_result<ResultType>::status result_state() const noexcept {
+                return symmetric_result_base<symmetric_result<ResultType>>::state();
+            }
+
+            // The next frame of a tail call completes the parent on error in place of this one.
+            void adopt_error_return(const task_result& other) noexcept {
+                if constexpr (is_expected_v<ResultType>) {
+                    this->error_return = other.error_return;
+                }
+            }
+
+            // An error awaited through try_await() completes the parent with that error
+            // instead of going to the parent as usual.
+            bool completes_parent_on_error() noexcept {
+                if constexpr (is_expected_v<ResultType>) {
+                    using status = symmetric_result<ResultType>::status;
+                    return this->error_return != nullptr && result_state() == status::value
+                        && !this->stored_value().has_value();
+                } else {
+                    return false;
+                }
+            }
+        };
+
+        // task<void> completes through return_void, it takes no tail call
+        template<>
+        class task_result<void> : public symmetric_result<void>
+        {
+        public:
+            symmetric_result<void>::status result_state() const noexcept {
+                return symmetric_result_base<symmetric_result<void>>::state();
+            }
+
+            void adopt_error_return(const task_result&) noexcept {}
+        };
+
+    } // namespace cocoro::details
+
     template<typename ResultType>
     class [[nodiscard]] task
     {
@@ -17,16 +146,93 @@ namespace cocoro {
         using handle_type = std::coroutine_handle<promise_type>;
 
         struct promise_type :
-            public basic_promise_base<env::trace_env>,
-            public symmetric_result<result_type>,
-            public env::trace_await_base
+            public basic_promise_base<env::default_trace_env, env::affine_env, env::stop_token_env, env::default_metrics_env>,
+            public details::task_result<result_type>,
+            public env::default_trace_await_base,
+            public frame_allocator_base
         {
+            using status = symmetric_result<result_type>::status;
+
             promise_type() = default;
 
+            ~promise_type() {
+                if (this->result_state() == status::tail_head) {
+                    handle_type::from_address(this->link()).destroy();
+                }
+            }
+
             task get_return_object() noexcept {
                 return task(handle_type::from_promise(*this));
             }
 
+            struct final_awaiter : std::suspend_always {
+                std::coroutine_handle<> await_suspend(handle_type handle) noexcept {
+                    return details::unwind_errors(handle.promise().complete(handle));
+                }
+            };
+
+            final_awaiter final_suspend() noexcept { return {}; }
+
+            // A tail call hands the continuation over to the next task in the chain,
+            // a task of a group or scope completes into the slot bound in its place,
+            // and an error awaited through try_await() names the parent to complete next.
+            details::error_unwind complete(handle_type handle) noexcept {
+                details::observe_complete(*this);
+                if (this->result_state() == status::tail_head) {
+                    handle_type successor = handle_type::from_address(this->link());
+                    successor.promise().adopt_error_return(*this);
+                    if (details::completion_slot* slot = bound_slot(); slot != nullptr && slot->takes_frame) {
+                        // No result to read through this frame, the successor stands alone.
+                        // Its env is fresh, an inherited one would refer to this frame.
+                        promise_type& next = successor.promise();
+                        next.set_completion_slot(*slot);
+                        static_cast<env::affine_env&>(next.get_mut_env()) = get_env();
+                        next.get_mut_env().set_stop_token(env::get_stop_token(get_env()));
+                        next.reset();
+                        this->reset();
+                        handle.destroy();
+                        return { .next = successor };
+                    }
+                    successor.promise().adopt_continuation(*this);
+                    return { .next = successor };
+                }
+                if (this->result_state() == status::tail_link) {
+                    promise_type& head = handle_type::from_address(this->link()).promise();
+                    handle_type successor = handle_type::from_address(head.link());
+                    successor.promise().adopt_continuation(head);
+                    successor.promise().adopt_error_return(head);
+                    handle.destroy(); // nothing reads this frame
+                    return { .next = successor };
+                }
+                if (details::completion_slot* slot = bound_slot()) {
+                    return { .next = slot->complete(*slot, handle, this->stored_exception(), false) };
+                }
+                if constexpr (details::is_expected_v<result_type>) {
+                    if (this->completes_parent_on_error()) {
+                        // destroys this frame
+                        return this->error_return->complete_parent(std::move(this->stored_value().error()));
+                    }
+                }
+                // as affine_final_awaiter does, completion is observed above
+                return { .next = details::continue_on(env::get_scheduler(get_env()), continuation()) };
+            }
+
+            // A task bound to a slot reports its own frame along with the stop.
+            std::coroutine_handle<> unhandled_stopped() noexcept {
+                if (details::completion_slot* slot = bound_slot()) {
+                    return slot->complete(*slot, handle_type::from_promise(*this), nullptr, true);
+                }
+                return basic_promise_base::unhandled_stopped();
+            }
+
+            // Promise holding the result, the last frame of a chain of tail calls.
+            promise_type& result_promise() noexcept {
+                if (this->result_state() == status::tail_head) {
+                    return handle_type::from_address(this->link()).promise();
+                }
+                return *this;
+            }
+
             void set_suspension_point_info(std::source_location&& loc) noexcept {
                 get_mut_env().set_suspension_point_info(std::move(loc));
             }
@@ -67,7 +273,7 @@ namespace cocoro {
             }
 
             result_type await_resume() {
-                return handle.promise().result();
+                return handle.promise().result_promise().result();
             }
 
             ~task_awaiter() {
@@ -91,6 +297,12 @@ namespace cocoro {
 
     private:
         friend promise_type;
+        friend details::task_result<result_type>;
+        template<typename T, typename E>
+        friend class details::try_awaiter;
+        template<typename State, typename T>
+        friend class details::join_child;
+        friend async_scope;
         explicit task(handle_type handle) noexcept :
             handle(handle)
         {}
@@ -98,6 +310,158 @@ namespace cocoro {
         handle_type handle = nullptr;
     };
 
+    // Returned by tail(), see below.
+    template<typename ResultType>
+    class [[nodiscard]] tail_call
+    {
+    public:
+        explicit tail_call(task<ResultType> child) noexcept : child(std::move(child)) {}
+
+    private:
+        friend details::task_result<ResultType>;
+        task<ResultType> child;
+    };
+
+    // `co_return tail(child());` completes the task with the result of `child`,
+    // which continues straight to the awaiting coroutine. The returning frame is released
+    // unless it started the chain, so deep delegation runs in constant memory.
+    // Since the returning frame may be gone by the time `child` runs, `child` must not
+    // refer to its locals or parameters, e.g. through reference or pointer parameters;
+    // pass such arguments by value.
+    // Not for task<void>, whose co_return takes no operand.
+    template<typename ResultType>
+        requires (not std::is_void_v<ResultType>)
+    tail_call<ResultType> tail(task<ResultType> child) noexcept {
+        return tail_call<ResultType>(std::move(child));
+    }
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    template<typename Promise, typename E>
+    concept error_completable_promise = requires (Promise& promise, std::coroutine_handle<Promise> handle, E&& error) {
+        promise.return_value(std::unexpected<E>(std::move(error)));
+        { promise.final_suspend().await_suspend(handle) } -> std::convertible_to<std::coroutine_handle<>>;
+    };
+
+    // Promises that complete step by step, so an error unwinds through them in a loop.
+    template<typename Promise>
+    concept error_unwinding_promise = requires (Promise& promise, std::coroutine_handle<Promise> handle) {
+        { promise.complete(handle) } noexcept -> std::same_as<error_unwind>;
+    };
+
+    template<typename Promise>
+    error_unwind complete_step(void* frame) noexcept {
+        auto handle = std::coroutine_handle<Promise>::from_address(frame);
+        return handle.promise().complete(handle);
+    }
+
+    // Completes the suspended `parent` as if it returned std::unexpected(error), without resuming it.
+    // The rest of its completion is left to the caller as the next step.
+    template<typename Promise, typename E>
+    error_unwind complete_with_error(void* parent, E&& error) noexcept {
+        auto handle = std::coroutine_handle<Promise>::from_address(parent);
+        handle.promise().return_value(std::unexpected<E>(std::move(error)));
+        if constexpr (error_unwinding_promise<Promise>) {
+            return { .step = &complete_step<Promise>, .frame = parent };
+        } else {
+            return { .next = handle.promise().final_suspend().await_suspend(handle) };
+        }
+    }
+
+    template<typename T, typename E>
+    class [[nodiscard]] try_awaiter
+    {
+    public:
+        using task_type = task<std::expected<T, E>>;
+        using handle_type = task_type::handle_type;
+
+        explicit try_awaiter(task_type&& child) noexcept :
+            handle(std::exchange(child.handle, nullptr))
+        {}
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) {
+            static_assert(error_completable_promise<Promise, E>,
+                "try_await() needs a coroutine that can co_return std::unexpected(error), such as task<std::expected<U, E>>");
+            auto& promise = handle.promise();
+            promise.set_continuation(caller);
+            promise.error_return = this;
+            parent = caller.address();
+            complete_with = &complete_with_error<Promise, E>;
+            return handle;
+        }
+
+        // Called by the last frame of the child, which holds `error`, on its final suspend.
+        // The error moves to the parent and the child is destroyed right away,
+        // so that frames of an unwound chain are not destroyed nested into each other later.
+        error_unwind complete_parent(E&& error) noexcept {
+            const error_unwind next = complete_with(parent, std::move(error));
+            std::exchange(handle, nullptr).destroy();
+            return next;
+        }
+
+        // resumed with a value or an exception only
+        T await_resume() {
+            return *handle.promise().result_promise().result();
+        }
+
+        ~try_awaiter() {
+            if (handle != nullptr) {
+                handle.destroy();
+            }
+        }
+
+    private:
+        handle_type handle = nullptr;
+        void* parent = nullptr;
+        error_unwind (*complete_with)(void* parent, E&& error) noexcept = nullptr;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // `co_await try_await(child())` yields the value of a task<std::expected<T, E>>.
+    // On error the awaiting coroutine is not resumed: it completes right away with
+    // std::unexpected(error), as if by co_return, and its own try_await()ing parent likewise,
+    // so errors travel up the chain by a flag check per frame, never by throwing,
+    // in a loop whatever the depth. Its locals are not destroyed at the failed await but
+    // along with its frame: right away if the error moves on to its own parent,
+    // otherwise by whoever awaits it, as for any completed task.
+    // The awaiting coroutine must be able to return it, e.g. a task<std::expected<U, E>>.
+    template<typename T, typename E>
+    details::try_awaiter<T, E> try_await(task<std::expected<T, E>> child) noexcept {
+        return details::try_awaiter<T, E>(std::move(child));
+    }
+
 } // namespace cocoro
 
+namespace cocoro::details {
+
+    // Promise footprint, every suspended task carries one.
+    // On LP64 targets it is the continuation, the stopped handler, one word per env
+    // (two for the trace entry, four for metrics) and the result slot, which fits
+    // a cache line for results up to a word unless metrics are enabled.
+    template<typename T>
+    inline constexpr std::size_t task_promise_size = sizeof(typename task<T>::promise_type);
+
+    inline constexpr std::size_t task_env_words =
+        (std::same_as<env::default_trace_env, env::trace_env> ? sizeof(env::trace_env) / sizeof(void*) : 0)
+        + (std::same_as<env::default_metrics_env, env::metrics_env> ? 4 : 0) + 2;
+
+    static_assert(sizeof(void*) != 8 || task_promise_size<void> == (4 + task_env_words) * sizeof(void*));
+    static_assert(sizeof(void*) != 8 || task_promise_size<int> == (4 + task_env_words) * sizeof(void*));
+    static_assert(sizeof(void*) != 8 || task_promise_size<void*> == (4 + task_env_words) * sizeof(void*));
+    static_assert(sizeof(void*) != 8 || task_promise_size<int&> == (4 + task_env_words) * sizeof(void*));
+#ifndef COCORO_ENABLE_COROTRACE_DUMP // live frame links take four more words
+    static_assert(sizeof(void*) != 8 || std::same_as<env::default_metrics_env, env::metrics_env>
+        || task_promise_size<int> <= 64);
+#endif
+
+} // namespace cocoro::details
+
 #endif // COCORO_SYMMETRIC_TASK_H
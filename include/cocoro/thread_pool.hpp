@@ -0,0 +1,347 @@
+#pragma once
+#ifndef COCORO_THREAD_POOL_H
+#define COCORO_THREAD_POOL_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/utils/futex.hpp"
+#include "cocoro/env/affine.hpp"
+#ifdef COCORO_ENABLE_PROFILER
+#include "cocoro/profiler.hpp"
+#endif
+
+namespace cocoro::details {
+
+    // Chase-Lev work stealing deque of coroutine handles.
+    // Owner pushes and pops at the bottom, thieves steal from the top.
+    class work_stealing_deque : private pinned
+    {
+    public:
+        work_stealing_deque() : array(new ring(initial_capacity)) {
+            retired.emplace_back(array.load(std::memory_order_relaxed));
+        }
+
+        // owner only
+        void push(std::coroutine_handle<> handle) {
+            const std::int64_t b = bottom.load(std::memory_order_relaxed);
+            const std::int64_t t = top.load(std::memory_order_acquire);
+            ring* a = array.load(std::memory_order_relaxed);
+            if (b - t > static_cast<std::int64_t>(a->mask)) {
+                a = grow(a, b, t);
+            }
+            a->put(b, handle.address());
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        // owner only
+        std::coroutine_handle<> pop() noexcept {
+            const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            ring* a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            void* addr = a->get(b);
+            if (t == b) {
+                // last element, race against thieves
+                if (!top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    addr = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return std::coroutine_handle<>::from_address(addr);
+        }
+
+        std::coroutine_handle<> steal() noexcept {
+            std::int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const std::int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            ring* a = array.load(std::memory_order_acquire);
+            void* addr = a->get(t);
+            if (!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr; // lost the race, caller moves on
+            }
+            return std::coroutine_handle<>::from_address(addr);
+        }
+
+        bool empty() const noexcept {
+            return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr std::size_t initial_capacity = 256;
+
+        struct ring {
+            explicit ring(std::size_t capacity) :
+                mask(capacity - 1),
+                slots(new std::atomic<void*>[capacity])
+            {}
+
+            void put(std::int64_t index, void* addr) noexcept {
+                slots[static_cast<std::size_t>(index) & mask].store(addr, std::memory_order_relaxed);
+            }
+
+            void* get(std::int64_t index) const noexcept {
+                return slots[static_cast<std::size_t>(index) & mask].load(std::memory_order_relaxed);
+            }
+
+            std::size_t mask;
+            std::unique_ptr<std::atomic<void*>[]> slots;
+        };
+
+        ring* grow(ring* old, std::int64_t b, std::int64_t t) {
+            ring* bigger = retired.emplace_back(new ring((old->mask + 1) * 2)).get();
+            for (std::int64_t i = t; i < b; ++i) {
+                bigger->put(i, old->get(i));
+            }
+            // thieves may still read the old ring, so it is kept alive until destruction
+            array.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+        alignas(64) std::atomic<std::int64_t> top = 0;
+        alignas(64) std::atomic<std::int64_t> bottom = 0;
+        std::atomic<ring*> array;
+        std::vector<std::unique_ptr<ring>> retired;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Work stealing multi-threaded scheduler.
+    // Coroutines posted from a worker go to its LIFO slot, the previous occupant
+    // is pushed to the worker's deque where idle workers can steal it.
+    // Coroutines posted from other threads go through a shared injection queue.
+    // Coroutines still queued when the pool is destroyed are leaked, not destroyed.
+    class thread_pool : private details::pinned
+    {
+    public:
+        explicit thread_pool(std::size_t thread_count = std::thread::hardware_concurrency()) :
+            workers(std::make_unique<worker[]>(thread_count == 0 ? 1 : thread_count)),
+            worker_count(thread_count == 0 ? 1 : thread_count),
+            self_ref(*this)
+        {
+            threads.reserve(worker_count);
+            for (std::size_t index = 0; index < worker_count; ++index) {
+                threads.emplace_back([this, index] { run_worker(index); });
+            }
+        }
+
+        ~thread_pool() {
+            stopping.store(true, std::memory_order_seq_cst);
+            wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+            details::futex_wake(wake_epoch, worker_count);
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+        }
+
+        std::size_t size() const noexcept { return worker_count; }
+
+        // Queues grow on demand, running out of memory there terminates, as the scheduler concept requires.
+        void post(std::coroutine_handle<> handle) noexcept {
+            if (worker* self = current_worker; self != nullptr && self->pool == this) {
+                void* displaced = self->lifo.exchange(handle.address(), std::memory_order_acq_rel);
+                if (displaced == nullptr) {
+                    return; // the worker will pick it up right after the current coroutine
+                }
+                self->deque.push(std::coroutine_handle<>::from_address(displaced));
+            } else {
+                std::scoped_lock lock(inject_mutex);
+                injected.push_back(handle);
+                injected_size.fetch_add(1, std::memory_order_seq_cst);
+            }
+            wake_one();
+        }
+
+        // Posts all of `handles` with one pass over the queue and a single wake for up to one idle worker per handle.
+        // From a worker they go to its deque, where idle workers steal them. Terminates like post() does.
+        void post_batch(std::span<const std::coroutine_handle<>> handles) noexcept {
+            if (handles.empty()) {
+                return;
+            }
+            if (worker* self = current_worker; self != nullptr && self->pool == this) {
+                for (std::coroutine_handle<> handle : handles) {
+                    self->deque.push(handle);
+                }
+            } else {
+                std::scoped_lock lock(inject_mutex);
+                injected.insert(injected.end(), handles.begin(), handles.end());
+                injected_size.fetch_add(handles.size(), std::memory_order_seq_cst);
+            }
+            wake_some(handles.size());
+        }
+
+        // co_await the result of this function to continue on the pool
+        scheduler_ref::schedule_awaiter schedule() const noexcept {
+            return self_ref.schedule();
+        }
+
+        const scheduler_ref& query(decltype(env::get_scheduler)) const noexcept {
+            return self_ref;
+        }
+
+    private:
+        struct worker : private details::pinned {
+            thread_pool* pool = nullptr;
+            alignas(64) std::atomic<void*> lifo = nullptr;
+            details::work_stealing_deque deque;
+            std::uint64_t rng = 0;
+        };
+
+        static inline thread_local worker* current_worker = nullptr;
+
+        void run_worker(std::size_t index) {
+            worker& self = workers[index];
+            self.pool = this;
+            self.rng = 0x9e3779b97f4a7c15ull * (index + 1);
+            current_worker = &self;
+            scheduler_scope scope(self_ref);
+#ifdef COCORO_ENABLE_PROFILER
+            profiler_thread_scope profiled;
+#endif
+
+            while (true) {
+                if (std::coroutine_handle<> handle = find_work(self)) {
+                    handle.resume();
+                    continue;
+                }
+                if (stopping.load(std::memory_order_acquire)) {
+                    break;
+                }
+                park();
+            }
+            current_worker = nullptr;
+        }
+
+        std::coroutine_handle<> find_work(worker& self) noexcept {
+            if (void* addr = self.lifo.exchange(nullptr, std::memory_order_acq_rel)) {
+                return std::coroutine_handle<>::from_address(addr);
+            }
+            if (std::coroutine_handle<> handle = self.deque.pop()) {
+                return handle;
+            }
+            if (std::coroutine_handle<> handle = take_injected()) {
+                return handle;
+            }
+            return steal(self);
+        }
+
+        std::coroutine_handle<> take_injected() noexcept {
+            if (injected_size.load(std::memory_order_relaxed) == 0) {
+                return nullptr;
+            }
+            std::scoped_lock lock(inject_mutex);
+            if (injected.empty()) {
+                return nullptr;
+            }
+            std::coroutine_handle<> handle = injected.front();
+            injected.pop_front();
+            injected_size.fetch_sub(1, std::memory_order_relaxed);
+            return handle;
+        }
+
+        std::coroutine_handle<> steal(worker& self) noexcept {
+            // xorshift, only used to spread thieves over victims
+            self.rng ^= self.rng << 13;
+            self.rng ^= self.rng >> 7;
+            self.rng ^= self.rng << 17;
+            const std::size_t start = static_cast<std::size_t>(self.rng % worker_count);
+            for (std::size_t offset = 0; offset < worker_count; ++offset) {
+                worker& victim = workers[(start + offset) % worker_count];
+                if (&victim == &self) {
+                    continue;
+                }
+                if (std::coroutine_handle<> handle = victim.deque.steal()) {
+                    return handle;
+                }
+                if (victim.lifo.load(std::memory_order_relaxed) != nullptr) {
+                    if (void* addr = victim.lifo.exchange(nullptr, std::memory_order_acq_rel)) {
+                        return std::coroutine_handle<>::from_address(addr);
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        bool has_work() const noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (injected_size.load(std::memory_order_seq_cst) != 0) {
+                return true;
+            }
+            for (std::size_t index = 0; index < worker_count; ++index) {
+                const worker& w = workers[index];
+                if (!w.deque.empty() || w.lifo.load(std::memory_order_seq_cst) != nullptr) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Futex style parking: announce idleness, recheck, then wait on the epoch.
+        void park() noexcept {
+            const std::uint32_t epoch = wake_epoch.load(std::memory_order_seq_cst);
+            idle_count.fetch_add(1, std::memory_order_seq_cst);
+            if (!has_work() && !stopping.load(std::memory_order_seq_cst)) {
+                details::futex_wait(wake_epoch, epoch);
+            }
+            idle_count.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        void wake_one() noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (idle_count.load(std::memory_order_seq_cst) != 0) {
+                wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+                details::futex_wake(wake_epoch);
+            }
+        }
+
+        // Wakes min(count, idle) workers to share out a batch, with a single futex wake.
+        void wake_some(std::size_t count) noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const std::size_t idle = idle_count.load(std::memory_order_seq_cst);
+            if (idle == 0) {
+                return;
+            }
+            wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+            details::futex_wake(wake_epoch, std::min(count, idle));
+        }
+
+        std::unique_ptr<worker[]> workers;
+        std::size_t worker_count;
+        scheduler_ref self_ref;
+        std::vector<std::thread> threads;
+
+        std::mutex inject_mutex;
+        std::deque<std::coroutine_handle<>> injected;
+        alignas(64) std::atomic<std::size_t> injected_size = 0;
+
+        alignas(64) std::atomic<std::uint32_t> wake_epoch = 0;
+        std::atomic<std::size_t> idle_count = 0;
+        std::atomic<bool> stopping = false;
+    };
+
+} // namespace cocoro
+
+#endif // COCORO_THREAD_POOL_H
@@ -0,0 +1,358 @@
+#pragma once
+#ifndef COCORO_TIMER_H
+#define COCORO_TIMER_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <utility>
+#include <variant>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/env/stop_token.hpp"
+#include "cocoro/task.hpp"
+#include "cocoro/when_any.hpp"
+
+namespace cocoro {
+
+    class timer_wheel;
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    // Intrusive timer entry, lives inside the awaiter.
+    class timer_node : private pinned
+    {
+    protected:
+        enum class state : unsigned char {
+            idle, armed, fired, cancelled,
+        };
+
+        timer_node* prev = nullptr;
+        timer_node* next = nullptr;
+        timer_node** owner_slot = nullptr; // slot list head, null when not in the wheel
+        timer_node* cancel_next = nullptr; // remote cancellation list
+        std::uint64_t expiry = 0;
+        std::atomic<state> status = state::idle;
+
+        std::coroutine_handle<> handle = nullptr;
+        stopped_handler_t stopped = &terminate_unhandled_stopped;
+
+        friend timer_wheel;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Hashed hierarchical timer wheel with millisecond ticks.
+    // 4 levels of 256 slots cover about 49 days, later deadlines are parked
+    // in the top level and cascade down until they fit.
+    // The wheel belongs to the scheduler thread driving it, which installs it with
+    // timer_wheel::scope, calls advance() every loop iteration and sleeps at most
+    // next_timeout(). Timers are inserted and cancelled in O(1); stop requests from
+    // foreign threads are handed over to the owner.
+    class timer_wheel : private details::pinned
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+        using duration = std::chrono::milliseconds;
+
+        explicit timer_wheel(scheduler_ref owner) noexcept :
+            owner(owner),
+            origin(clock::now())
+        {}
+
+        // Installs a wheel as the one serving timers awaited on this thread.
+        class scope : private details::pinned
+        {
+        public:
+            explicit scope(timer_wheel& wheel) noexcept :
+                prev(std::exchange(current_wheel, &wheel))
+            {}
+
+            ~scope() { current_wheel = prev; }
+
+        private:
+            timer_wheel* prev;
+        };
+
+        static timer_wheel* current() noexcept { return current_wheel; }
+
+        bool empty() const noexcept { return armed_count == 0; }
+
+        // Fire every timer due by `now`, and settle cancellations from other threads.
+        void advance(clock::time_point now = clock::now()) {
+            settle_cancelled();
+            const std::uint64_t target = to_tick(now);
+            if (armed_count == 0) {
+                now_tick = std::max(now_tick, target);
+                return;
+            }
+            while (now_tick < target) {
+                ++now_tick;
+                cascade();
+                fire_due();
+            }
+        }
+
+        // Time until the wheel has to advance again, nullopt if no timer is armed.
+        std::optional<duration> next_timeout() const noexcept {
+            if (armed_count == 0) {
+                return std::nullopt;
+            }
+            const std::uint64_t until_wrap = slot_count - (now_tick & slot_mask);
+            for (std::uint64_t delta = 1; delta < until_wrap; ++delta) {
+                if (slots[0][(now_tick + delta) & slot_mask] != nullptr) {
+                    return duration(delta);
+                }
+            }
+            return duration(until_wrap);
+        }
+
+        std::uint64_t to_tick(clock::time_point tp) const noexcept {
+            if (tp <= origin) {
+                return 0;
+            }
+            // round up, never fire early
+            return static_cast<std::uint64_t>(
+                std::chrono::ceil<duration>(tp - origin).count());
+        }
+
+        // owner thread only
+        void insert(details::timer_node& node, clock::time_point deadline) noexcept {
+            node.expiry = std::max(to_tick(deadline), now_tick + 1);
+            node.status.store(details::timer_node::state::armed, std::memory_order_relaxed);
+            ++armed_count;
+            link(node);
+        }
+
+        // owner thread only, no-op if the timer is no longer in the wheel
+        void remove(details::timer_node& node) noexcept {
+            if (is_linked(node)) {
+                unlink(node);
+                --armed_count;
+            }
+        }
+
+        // any thread, the node resumes through its stopped path on the owner thread
+        bool cancel(details::timer_node& node) noexcept {
+            auto expected = details::timer_node::state::armed;
+            if (!node.status.compare_exchange_strong(expected, details::timer_node::state::cancelled,
+                std::memory_order_acq_rel)) {
+                return false; // already fired
+            }
+            {
+                std::scoped_lock lock(cancel_mutex);
+                node.cancel_next = std::exchange(cancelled_head, &node);
+            }
+            owner.post(std::noop_coroutine()); // wake up the owner
+            return true;
+        }
+
+    private:
+        static constexpr unsigned level_count = 4;
+        static constexpr unsigned slot_bits = 8;
+        static constexpr std::uint64_t slot_count = std::uint64_t{ 1 } << slot_bits;
+        static constexpr std::uint64_t slot_mask = slot_count - 1;
+        static constexpr std::uint64_t span = std::uint64_t{ 1 } << (slot_bits * level_count);
+
+        static inline thread_local timer_wheel* current_wheel = nullptr;
+
+        static bool is_linked(const details::timer_node& node) noexcept {
+            return node.owner_slot != nullptr;
+        }
+
+        details::timer_node** slot_for(const details::timer_node& node) noexcept {
+            std::uint64_t key = node.expiry;
+            const std::uint64_t delta = key - now_tick;
+            if (delta >= span) {
+                key = now_tick + span - 1; // park in the farthest slot
+            }
+            unsigned level = 0;
+            while (level + 1 < level_count && (key - now_tick) >= (std::uint64_t{ 1 } << (slot_bits * (level + 1)))) {
+                ++level;
+            }
+            return &slots[level][(key >> (slot_bits * level)) & slot_mask];
+        }
+
+        void link(details::timer_node& node) noexcept {
+            details::timer_node** slot = slot_for(node);
+            node.owner_slot = slot;
+            node.prev = nullptr;
+            node.next = *slot;
+            if (node.next != nullptr) {
+                node.next->prev = &node;
+            }
+            *slot = &node;
+        }
+
+        void unlink(details::timer_node& node) noexcept {
+            if (node.prev != nullptr) {
+                node.prev->next = node.next;
+            } else {
+                *node.owner_slot = node.next;
+            }
+            if (node.next != nullptr) {
+                node.next->prev = node.prev;
+            }
+            node.prev = node.next = nullptr;
+            node.owner_slot = nullptr;
+        }
+
+        // Redistribute higher level slots whose range starts at the current tick.
+        void cascade() noexcept {
+            for (unsigned level = 1; level < level_count; ++level) {
+                if (((now_tick >> (slot_bits * (level - 1))) & slot_mask) != 0) {
+                    break;
+                }
+                details::timer_node*& slot = slots[level][(now_tick >> (slot_bits * level)) & slot_mask];
+                details::timer_node* node = std::exchange(slot, nullptr);
+                while (node != nullptr) {
+                    details::timer_node* next = node->next;
+                    node->prev = node->next = nullptr;
+                    link(*node);
+                    node = next;
+                }
+            }
+        }
+
+        void fire_due() {
+            details::timer_node*& slot = slots[0][now_tick & slot_mask];
+            // resumed coroutines may touch the wheel, so take one node at a time
+            while (slot != nullptr) {
+                details::timer_node& node = *slot;
+                unlink(node);
+                --armed_count;
+                auto expected = details::timer_node::state::armed;
+                if (node.status.compare_exchange_strong(expected, details::timer_node::state::fired,
+                    std::memory_order_acq_rel)) {
+                    node.handle.resume();
+                }
+                // otherwise cancelled concurrently, settled through the cancellation list
+            }
+        }
+
+        void settle_cancelled() {
+            details::timer_node* node = nullptr;
+            {
+                std::scoped_lock lock(cancel_mutex);
+                node = std::exchange(cancelled_head, nullptr);
+            }
+            while (node != nullptr) {
+                details::timer_node& current = *std::exchange(node, node->cancel_next);
+                remove(current);
+                current.stopped(current.handle.address()).resume();
+            }
+        }
+
+        scheduler_ref owner;
+        clock::time_point origin;
+        std::uint64_t now_tick = 0;
+        std::size_t armed_count = 0;
+        details::timer_node* slots[level_count][slot_count] = {};
+
+        std::mutex cancel_mutex;
+        details::timer_node* cancelled_head = nullptr;
+    };
+
+    class [[nodiscard]] sleep_awaiter : private details::timer_node
+    {
+    public:
+        explicit sleep_awaiter(timer_wheel::clock::time_point deadline) noexcept : deadline(deadline) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) {
+            wheel = timer_wheel::current();
+            if (wheel == nullptr) {
+                throw std::logic_error("no timer wheel drives the current thread");
+            }
+            handle = caller;
+            std::inplace_stop_token token;
+            if constexpr (stoppable_promise<Promise>) {
+                token = env::get_stop_token(caller.promise().get_env());
+                if (token.stop_requested()) {
+                    return caller.promise().unhandled_stopped();
+                }
+                stopped = &default_unhandled_stopped_handler<Promise>;
+            }
+            wheel->insert(*this, deadline);
+            if (token.stop_possible()) {
+                on_stop.emplace(token, cancel_fn{ this });
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+
+        ~sleep_awaiter() {
+            on_stop.reset();
+            if (wheel != nullptr && status.load(std::memory_order_relaxed) == state::armed) {
+                wheel->remove(*this); // coroutine destroyed while sleeping
+            }
+        }
+
+    private:
+        struct cancel_fn {
+            sleep_awaiter* self;
+            void operator()() const noexcept { self->wheel->cancel(*self); }
+        };
+
+        timer_wheel::clock::time_point deadline;
+        timer_wheel* wheel = nullptr;
+        std::optional<std::inplace_stop_callback<cancel_fn>> on_stop;
+    };
+
+    // co_await the result of these functions to suspend on the timer wheel of the current thread.
+    // Stop requests through the env stop token cancel the sleep and stop the awaiting coroutine.
+
+    inline sleep_awaiter sleep_until(timer_wheel::clock::time_point deadline) noexcept {
+        return sleep_awaiter(deadline);
+    }
+
+    template<typename Rep, typename Period>
+    sleep_awaiter sleep_for(std::chrono::duration<Rep, Period> duration) noexcept {
+        return sleep_awaiter(timer_wheel::clock::now()
+            + std::chrono::ceil<timer_wheel::clock::duration>(duration));
+    }
+
+    namespace details {
+
+        inline task<void> deadline_timer(timer_wheel::clock::time_point deadline) {
+            co_await sleep_until(deadline);
+        }
+
+    } // namespace details
+
+    // Run `work`, stopping it and then the awaiting coroutine if it is not done by `duration`.
+    template<typename T, typename Rep, typename Period>
+    task<T> with_deadline(task<T> work, std::chrono::duration<Rep, Period> duration) {
+        const auto deadline = timer_wheel::clock::now()
+            + std::chrono::ceil<timer_wheel::clock::duration>(duration);
+        auto result = co_await when_any(std::move(work), details::deadline_timer(deadline));
+        if (result.index() == 1) {
+            co_await stopped();
+        }
+        if constexpr (std::is_void_v<T>) {
+            co_return;
+        } else if constexpr (std::is_reference_v<T>) {
+            co_return std::get<0>(result).get();
+        } else {
+            co_return std::get<0>(std::move(result));
+        }
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_TIMER_H
@@ -2,9 +2,13 @@
 #ifndef COCORO_COROUTILS_H
 #define COCORO_COROUTILS_H 1
 
+#include <atomic>
 #include <concepts>
 #include <exception>
 #include <coroutine>
+#include <utility>
+
+#include "cocoro/env/active_trace.hpp"
 
 namespace cocoro::details {
 
@@ -17,9 +21,37 @@ namespace cocoro::details {
         ~pinned() = default;
     };
 
+    // Spin lock guard, for critical sections of a few instructions.
+    class spin_guard : private pinned
+    {
+    public:
+        explicit spin_guard(std::atomic_flag& lock) noexcept : lock(lock) {
+            while (lock.test_and_set(std::memory_order_acquire)) {
+                while (lock.test(std::memory_order_relaxed)) {}
+            }
+        }
+
+        ~spin_guard() { lock.clear(std::memory_order_release); }
+
+    private:
+        std::atomic_flag& lock;
+    };
+
     // TODO: replace with std::monostate when it is put into <utility>
     struct monostate {};
 
+    // Awaiter obtained from an awaitable the way co_await does, for awaiter wrappers.
+    template<typename T>
+    decltype(auto) get_awaiter(T&& awaitable) {
+        if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+            return std::forward<T>(awaitable).operator co_await();
+        } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+            return operator co_await(std::forward<T>(awaitable));
+        } else {
+            return std::forward<T>(awaitable);
+        }
+    }
+
 } // namespace cocoro::details
 
 namespace cocoro {
@@ -32,6 +64,7 @@ namespace cocoro {
     struct continue_final_awaiter : std::suspend_always {
         template<continuable_promise Promise>
         std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            details::observe_complete(handle.promise());
             return handle.promise().continuation();
         }
     };
@@ -56,4 +89,27 @@ namespace cocoro {
 
 } // namespace cocoro
 
+namespace cocoro::details {
+
+    // Stands in for the continuation of a coroutine that completes into a group or a scope
+    // rather than into an awaiting coroutine, see basic_promise_base::set_completion_slot.
+    // `complete` gets the frame completing, and its exception if it failed.
+    struct completion_slot {
+        using complete_fn = std::coroutine_handle<> (*)(completion_slot& slot, std::coroutine_handle<> frame,
+            const std::exception_ptr* error, bool stopped) noexcept;
+        complete_fn complete;
+        // Nobody reads the result: the slot destroys the frame that completes into it,
+        // and frames of a tail call chain are released as they hand over.
+        bool takes_frame = false;
+    };
+
+    // Stopped handler of coroutines bound to a slot, which also tells them apart.
+    // Promises that know their own frame report it instead, see task<T>.
+    inline std::coroutine_handle<> completion_slot_stopped(void* slot) noexcept {
+        completion_slot& self = *static_cast<completion_slot*>(slot);
+        return self.complete(self, nullptr, nullptr, true);
+    }
+
+} // namespace cocoro::details
+
 #endif // COCORO_COROUTILS_H
@@ -4,24 +4,32 @@
 
 #include <type_traits>
 #include <coroutine>
-#include <optional>
+#include <memory>
 
 #include "cocoro/utils/basic.hpp"
 #include "cocoro/env/env.hpp"
+#include "cocoro/env/affine.hpp"
+#ifdef COCORO_OBSERVE_AWAITS
+#include "cocoro/env/trace.hpp"
+#endif
 
 namespace cocoro {
 
+    // Env storage is engaged exactly when a continuation is set,
+    // so it needs no flag of its own as std::optional would.
     template<typename... Envs>
     class basic_promise_base : private details::pinned
     {
     public:
-        basic_promise_base() = default;
-
         using env_type = env::composed_environment<Envs...>;
 
-        const env_type& get_env() const noexcept { return *env; }
+        basic_promise_base() noexcept {}
+
+        ~basic_promise_base() { reset_env(); }
 
-        env_type& get_mut_env() noexcept { return *env; }
+        const env_type& get_env() const noexcept { return env; }
+
+        env_type& get_mut_env() noexcept { return env; }
 
         template<env::eligible_query_for<env_type> Query>
         env::query_result_t<env_type, Query> query(Query q) const noexcept {
@@ -31,10 +39,11 @@ namespace cocoro {
         template<typename OtherPromise>
             requires (not std::same_as<OtherPromise, void>)
         void set_continuation(std::coroutine_handle<OtherPromise> handle) noexcept {
+            reset_env();
             if constexpr (env::env_aware<OtherPromise>) {
-                env.emplace(env::inherit, handle.promise().get_env());
-            } else if constexpr (std::is_default_constructible_v<env_type>) {
-                env.emplace();
+                std::construct_at(std::addressof(env), env::inherit, handle.promise().get_env());
+            } else {
+                std::construct_at(std::addressof(env));
             }
 
             if constexpr (unhandled_stopped_aware_promise<OtherPromise>) {
@@ -43,17 +52,83 @@ namespace cocoro {
                 stopped_handler = &terminate_unhandled_stopped;
             }
 
-            cont = handle;
+            cont = handle.address();
+        }
+
+        // Complete into `slot` instead of resuming `parent`, whose env is inherited all the same.
+        template<typename OtherPromise>
+        void set_completion_slot(details::completion_slot& slot, std::coroutine_handle<OtherPromise> parent) noexcept {
+            set_continuation(parent);
+            stopped_handler = &details::completion_slot_stopped;
+            cont = std::addressof(slot);
         }
 
-        std::coroutine_handle<> continuation() const noexcept { return cont; }
+        // Complete into `slot` with a fresh env, for coroutines nobody awaits.
+        void set_completion_slot(details::completion_slot& slot) noexcept {
+            reset_env();
+            std::construct_at(std::addressof(env));
+            stopped_handler = &details::completion_slot_stopped;
+            cont = std::addressof(slot);
+        }
+
+        // Continue where `other` would have, as if `other` awaited this coroutine.
+        // `other` stays alive until this coroutine completes.
+        void adopt_continuation(const basic_promise_base& other) noexcept {
+            reset_env();
+            std::construct_at(std::addressof(env), env::inherit, other.env);
+            stopped_handler = other.stopped_handler;
+            cont = other.cont;
+        }
+
+        // Only meaningful when the coroutine is not bound to a slot.
+        std::coroutine_handle<> continuation() const noexcept { return std::coroutine_handle<>::from_address(cont); }
+
+        // Slot the coroutine completes into, null if it resumes a continuation.
+        details::completion_slot* bound_slot() const noexcept {
+            return stopped_handler == &details::completion_slot_stopped ? static_cast<details::completion_slot*>(cont) : nullptr;
+        }
+
+        // Cancelled awaits unwind to the continuation through its stopped path.
+        std::coroutine_handle<> unhandled_stopped() noexcept {
+            return stopped_handler(cont);
+        }
+
+#ifdef COCORO_OBSERVE_AWAITS
+        // Reports the coroutine once started, see details::observe_start.
+        struct initial_awaiter : std::suspend_always {
+            const basic_promise_base* self;
+
+            void await_resume() const noexcept {
+                details::observe_start(*self);
+            }
+        };
+
+        initial_awaiter initial_suspend() noexcept { return { {}, this }; }
+#else
         std::suspend_always initial_suspend() noexcept { return {}; }
-        continue_final_awaiter final_suspend() noexcept { return {}; }
+#endif
+        auto final_suspend() noexcept {
+            if constexpr (env::queryable<env_type, decltype(env::get_scheduler)>) {
+                return affine_final_awaiter{};
+            } else {
+                return continue_final_awaiter{};
+            }
+        }
 
     private:
-        std::coroutine_handle<> cont = nullptr;
+        void reset_env() noexcept {
+            if constexpr (!std::is_trivially_destructible_v<env_type>) {
+                if (cont != nullptr) {
+                    env.~env_type();
+                }
+            }
+        }
+
+        void* cont = nullptr; // continuation, or the slot bound to
         stopped_handler_t stopped_handler = &terminate_unhandled_stopped;
-        std::optional<env_type> env = std::nullopt;
+        union {
+            env_type env;
+        };
     };
 
 } // namespace cocoro
@@ -0,0 +1,363 @@
+#pragma once
+#ifndef COCORO_UTILITYS_FRAME_ALLOCATOR_H
+#define COCORO_UTILITYS_FRAME_ALLOCATOR_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <concepts>
+#include <utility>
+
+#include "./basic.hpp"
+
+namespace cocoro {
+
+    // Frame pool activity of one thread, see this_thread::snapshot_frame_pool_stats().
+    struct frame_pool_stats {
+        std::size_t hits = 0;     // pooled allocations served from the cache
+        std::size_t misses = 0;   // pooled allocations that went to the heap
+        std::size_t unpooled = 0; // frames too large to pool
+        std::size_t refills = 0;  // chains taken from the global overflow by an empty bucket
+        std::size_t spills = 0;   // chains given to the global overflow by a full bucket
+
+        // Share of pooled allocations served without the heap.
+        double hit_rate() const noexcept {
+            const std::size_t pooled = hits + misses;
+            return pooled == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(pooled);
+        }
+    };
+
+} // namespace cocoro
+
+namespace cocoro::details {
+
+    constexpr std::size_t align_up(std::size_t size, std::size_t align) noexcept {
+        return (size + align - 1) & ~(align - 1);
+    }
+
+    // Thread local cache of coroutine frames, bucketed by size class.
+    // Classes are as fine as the default new alignment, so every coroutine function
+    // whose frame is in pooled range gets a freelist of frames of its exact size;
+    // the class of a given coroutine folds to a constant once operator new is inlined.
+    // A full bucket spills a chain of frames into a bounded global overflow, an empty one
+    // refills from there, so that frames freed by another thread than the one which
+    // allocated them come back into use. Both the cache and the overflow are bounded
+    // in bytes, frames beyond that go back to the heap.
+    // Kept trivially destructible so that frames released during thread
+    // (or static) teardown can still reach it after the reaper has run.
+    class frame_pool
+    {
+    public:
+        static constexpr std::size_t granularity = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+        static constexpr std::size_t class_count = 1024 / granularity; // frames up to 1 KiB are pooled
+        static constexpr std::size_t max_cached = 256; // frames per size class
+        static constexpr std::size_t max_cached_bytes = 256 * 1024; // all size classes together
+        static constexpr std::size_t chain_length = 64; // frames moved to or from the overflow at once
+
+        static frame_pool& local() noexcept {
+            thread_local constinit frame_pool pool;
+            thread_local reaper guard(pool);
+            return pool;
+        }
+
+        void* allocate(std::size_t size) {
+            const std::size_t index = size_class(size);
+            if (index >= class_count) {
+                ++stats.unpooled;
+                return ::operator new(size);
+            }
+            bucket& b = buckets[index];
+            if (b.head == nullptr && !retired && cached_bytes + chain_bytes(index) <= max_cached_bytes) {
+                if (free_block* chain = overflow::global().pop(index)) {
+                    ++stats.refills;
+                    b.head = chain;
+                    b.count = chain_length;
+                    cached_bytes += chain_bytes(index);
+                }
+            }
+            if (b.head != nullptr) {
+                ++stats.hits;
+                free_block* block = b.head;
+                b.head = block->next;
+                --b.count;
+                cached_bytes -= class_size(index);
+                return block;
+            }
+            ++stats.misses;
+            return ::operator new(class_size(index));
+        }
+
+        void deallocate(void* p, std::size_t size) noexcept {
+            const std::size_t index = size_class(size);
+            if (index >= class_count) {
+                ::operator delete(p, size);
+                return;
+            }
+            if (retired) {
+                ::operator delete(p, class_size(index));
+                return;
+            }
+            bucket& b = buckets[index];
+            if (b.count >= max_cached || cached_bytes + class_size(index) > max_cached_bytes) {
+                if (b.count < chain_length) {
+                    // the budget is held by other size classes
+                    ::operator delete(p, class_size(index));
+                    return;
+                }
+                spill(index, b);
+            }
+            b.head = ::new (p) free_block{ b.head };
+            ++b.count;
+            cached_bytes += class_size(index);
+        }
+
+        const frame_pool_stats& statistics() const noexcept { return stats; }
+
+    private:
+        struct free_block {
+            free_block* next;
+        };
+
+        struct bucket {
+            free_block* head = nullptr;
+            std::size_t count = 0;
+        };
+
+        // Chains of chain_length frames per size class, shared by all threads.
+        // What it still holds at exit is left to the OS, like what a parked thread caches.
+        class overflow
+        {
+        public:
+            static constexpr std::size_t max_chains = 8; // per size class
+            static constexpr std::size_t max_bytes = 4 * 1024 * 1024; // all size classes together
+
+            static overflow& global() noexcept {
+                static constinit overflow instance;
+                return instance;
+            }
+
+            bool push(std::size_t index, free_block* chain) noexcept {
+                if (!reserve(chain_bytes(index))) {
+                    return false;
+                }
+                slot& s = slots[index];
+                const spin_guard guard(s.lock);
+                const std::size_t count = s.count.load(std::memory_order_relaxed);
+                if (count == max_chains) {
+                    bytes.fetch_sub(chain_bytes(index), std::memory_order_relaxed);
+                    return false;
+                }
+                s.chains[count] = chain;
+                s.count.store(count + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            free_block* pop(std::size_t index) noexcept {
+                slot& s = slots[index];
+                if (s.count.load(std::memory_order_relaxed) == 0) {
+                    return nullptr; // skip the lock while empty
+                }
+                const spin_guard guard(s.lock);
+                const std::size_t count = s.count.load(std::memory_order_relaxed);
+                if (count == 0) {
+                    return nullptr;
+                }
+                s.count.store(count - 1, std::memory_order_relaxed);
+                bytes.fetch_sub(chain_bytes(index), std::memory_order_relaxed);
+                return s.chains[count - 1];
+            }
+
+        private:
+            struct slot {
+                std::atomic_flag lock;
+                std::atomic<std::size_t> count = 0; // written under the lock only
+                free_block* chains[max_chains] = {};
+            };
+
+            bool reserve(std::size_t size) noexcept {
+                std::size_t held = bytes.load(std::memory_order_relaxed);
+                do {
+                    if (held + size > max_bytes) {
+                        return false;
+                    }
+                } while (!bytes.compare_exchange_weak(held, held + size, std::memory_order_relaxed));
+                return true;
+            }
+
+            std::atomic<std::size_t> bytes = 0;
+            slot slots[class_count] = {};
+        };
+
+        // Drains the pool on thread exit, later frees bypass the cache.
+        struct reaper : private pinned {
+            frame_pool& pool;
+            explicit reaper(frame_pool& pool) noexcept : pool(pool) {}
+            ~reaper() { pool.drain(); }
+        };
+
+        static constexpr std::size_t size_class(std::size_t size) noexcept {
+            return (size - 1) / granularity;
+        }
+
+        static constexpr std::size_t class_size(std::size_t index) noexcept {
+            return (index + 1) * granularity;
+        }
+
+        static constexpr std::size_t chain_bytes(std::size_t index) noexcept {
+            return chain_length * class_size(index);
+        }
+
+        // Hands the first chain_length frames of a full bucket to the overflow,
+        // or back to the heap when the overflow is full as well.
+        void spill(std::size_t index, bucket& b) noexcept {
+            free_block* chain = b.head;
+            free_block* last = chain;
+            for (std::size_t n = 1; n < chain_length; ++n) {
+                last = last->next;
+            }
+            b.head = std::exchange(last->next, nullptr);
+            b.count -= chain_length;
+            cached_bytes -= chain_bytes(index);
+            if (overflow::global().push(index, chain)) {
+                ++stats.spills;
+                return;
+            }
+            while (chain != nullptr) {
+                ::operator delete(std::exchange(chain, chain->next), class_size(index));
+            }
+        }
+
+        void drain() noexcept {
+            retired = true;
+            for (std::size_t index = 0; index < class_count; ++index) {
+                bucket& b = buckets[index];
+                while (b.head != nullptr) {
+                    ::operator delete(std::exchange(b.head, b.head->next), class_size(index));
+                }
+                b.count = 0;
+            }
+            cached_bytes = 0;
+        }
+
+        bucket buckets[class_count] = {};
+        std::size_t cached_bytes = 0;
+        frame_pool_stats stats = {};
+        bool retired = false;
+    };
+
+    // Every frame carries a trailing deallocation routine,
+    // so that operator delete can tell how the frame was obtained.
+    using frame_deallocate_fn = void(*)(void* frame, std::size_t size) noexcept;
+
+    constexpr std::size_t frame_deallocator_offset(std::size_t size) noexcept {
+        return align_up(size, alignof(frame_deallocate_fn));
+    }
+
+    constexpr std::size_t pooled_frame_size(std::size_t size) noexcept {
+        return frame_deallocator_offset(size) + sizeof(frame_deallocate_fn);
+    }
+
+    template<typename Alloc>
+    constexpr std::size_t frame_allocator_offset(std::size_t size) noexcept {
+        return align_up(pooled_frame_size(size), alignof(Alloc));
+    }
+
+    // Allocation unit that keeps frames aligned as global operator new would do.
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_block {
+        std::byte storage[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+    };
+
+    template<typename Alloc>
+    using frame_block_allocator = std::allocator_traits<Alloc>::template rebind_alloc<frame_block>;
+
+    template<typename Alloc>
+    constexpr std::size_t frame_block_count(std::size_t size) noexcept {
+        const std::size_t total = frame_allocator_offset<Alloc>(size) + sizeof(Alloc);
+        return align_up(total, sizeof(frame_block)) / sizeof(frame_block);
+    }
+
+    inline void set_frame_deallocator(void* frame, std::size_t size, frame_deallocate_fn fn) noexcept {
+        ::new (static_cast<std::byte*>(frame) + frame_deallocator_offset(size)) frame_deallocate_fn(fn);
+    }
+
+    inline frame_deallocate_fn get_frame_deallocator(void* frame, std::size_t size) noexcept {
+        return *std::launder(reinterpret_cast<frame_deallocate_fn*>(
+            static_cast<std::byte*>(frame) + frame_deallocator_offset(size)));
+    }
+
+    inline void pooled_frame_deallocate(void* frame, std::size_t size) noexcept {
+        frame_pool::local().deallocate(frame, pooled_frame_size(size));
+    }
+
+    template<typename Alloc>
+    void allocator_frame_deallocate(void* frame, std::size_t size) noexcept {
+        using block_alloc = frame_block_allocator<Alloc>;
+        Alloc* stored = std::launder(reinterpret_cast<Alloc*>(
+            static_cast<std::byte*>(frame) + frame_allocator_offset<Alloc>(size)));
+        block_alloc alloc(std::move(*stored));
+        stored->~Alloc();
+        std::allocator_traits<block_alloc>::deallocate(alloc,
+            static_cast<frame_block*>(frame), frame_block_count<Alloc>(size));
+    }
+
+    template<typename Alloc>
+    void* allocator_frame_allocate(std::size_t size, const Alloc& source) {
+        using block_alloc = frame_block_allocator<Alloc>;
+        block_alloc alloc(source);
+        void* frame = std::allocator_traits<block_alloc>::allocate(alloc, frame_block_count<Alloc>(size));
+        ::new (static_cast<std::byte*>(frame) + frame_allocator_offset<Alloc>(size)) Alloc(source);
+        set_frame_deallocator(frame, size, &allocator_frame_deallocate<Alloc>);
+        return frame;
+    }
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    template<typename Alloc>
+    concept frame_allocator = requires { typename Alloc::value_type; }
+        && std::is_object_v<typename Alloc::value_type> // not e.g. symmetric_result<T&>
+        && requires (Alloc& alloc, std::size_t n) { alloc.allocate(n); } // not e.g. a container
+        && requires (const Alloc& alloc) {
+            details::frame_block_allocator<Alloc>(alloc);
+        };
+
+    // Derive promise types from this class to allocate coroutine frames from
+    // the thread local frame pool. Coroutines whose leading arguments are
+    // `std::allocator_arg, alloc` (after the object argument for member coroutines)
+    // allocate their frames from `alloc` instead.
+    struct frame_allocator_base {
+        static void* operator new(std::size_t size) {
+            void* frame = details::frame_pool::local().allocate(details::pooled_frame_size(size));
+            details::set_frame_deallocator(frame, size, &details::pooled_frame_deallocate);
+            return frame;
+        }
+
+        template<frame_allocator Alloc, typename... Args>
+        static void* operator new(std::size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...) {
+            return details::allocator_frame_allocate(size, alloc);
+        }
+
+        template<typename Object, frame_allocator Alloc, typename... Args>
+        static void* operator new(std::size_t size, const Object&, std::allocator_arg_t, const Alloc& alloc, const Args&...) {
+            return details::allocator_frame_allocate(size, alloc);
+        }
+
+        static void operator delete(void* frame, std::size_t size) noexcept {
+            details::get_frame_deallocator(frame, size)(frame, size);
+        }
+    };
+
+} // namespace cocoro
+
+namespace cocoro::this_thread {
+
+    // Counters of the frame pool of the calling thread since it started.
+    inline frame_pool_stats snapshot_frame_pool_stats() noexcept {
+        return details::frame_pool::local().statistics();
+    }
+
+} // namespace cocoro::this_thread
+
+#endif // COCORO_UTILITYS_FRAME_ALLOCATOR_H
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef COCORO_UTILITYS_FUTEX_H
+#define COCORO_UTILITYS_FUTEX_H 1
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace cocoro::details {
+
+    // Raw futex on an atomic word, for what std::atomic::wait and notify cannot do:
+    // time out, or wake a given number of waiters at once.
+    // A word used here must not be waited on or notified through std::atomic as well.
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t)
+        && std::atomic<std::uint32_t>::is_always_lock_free);
+
+    // Spurious returns, EAGAIN and EINTR are all left to the caller to recheck.
+    inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+        std::optional<std::chrono::milliseconds> timeout = std::nullopt) noexcept {
+        ::timespec relative{};
+        if (timeout) {
+            relative.tv_sec = static_cast<::time_t>(timeout->count() / 1000);
+            relative.tv_nsec = static_cast<long>(timeout->count() % 1000) * 1'000'000;
+        }
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected,
+            timeout ? &relative : nullptr, nullptr, 0);
+    }
+
+    // Wakes up to `count` waiters with a single syscall.
+    inline void futex_wake(std::atomic<std::uint32_t>& word, std::size_t count = 1) noexcept {
+        const int waiters = count > static_cast<std::size_t>(INT_MAX) ? INT_MAX : static_cast<int>(count);
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, waiters, nullptr, nullptr, 0);
+    }
+
+} // namespace cocoro::details
+
+#endif // COCORO_UTILITYS_FUTEX_H
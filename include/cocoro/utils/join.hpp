@@ -0,0 +1,118 @@
+#pragma once
+#ifndef COCORO_UTILITYS_JOIN_H
+#define COCORO_UTILITYS_JOIN_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <variant>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+#include "cocoro/task.hpp"
+
+namespace cocoro::details {
+
+    // Result slot of a child in a group, void results become std::monostate.
+    template<typename T>
+    using join_result_t = std::conditional_t<std::is_void_v<T>, std::monostate,
+        std::conditional_t<std::is_reference_v<T>,
+            std::reference_wrapper<std::remove_reference_t<T>>, T>>;
+
+    // Countdown shared by children of a group, with one extra count held
+    // by the awaiting coroutine while it starts the children.
+    class join_state : private pinned
+    {
+    public:
+        explicit join_state(std::size_t children) noexcept : pending(children + 1) {}
+
+        template<typename Promise>
+        void set_parent(std::coroutine_handle<Promise> handle) noexcept {
+            parent = handle;
+            home = this_thread::current_scheduler();
+            if constexpr (unhandled_stopped_aware_promise<Promise>) {
+                parent_stopped = &default_unhandled_stopped_handler<Promise>;
+            }
+        }
+
+        // True for the last one to arrive, who then calls complete().
+        bool arrive() noexcept {
+            return pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+        // Coroutine to continue with, the parent or its stopped path.
+        std::coroutine_handle<> complete(bool stopped) noexcept {
+            if (stopped) {
+                return parent_stopped(parent.address());
+            }
+            return continue_on(home, parent);
+        }
+
+    private:
+        std::atomic<std::size_t> pending;
+        scheduler_ref home = {};
+        std::coroutine_handle<> parent = nullptr;
+        stopped_handler_t parent_stopped = &terminate_unhandled_stopped;
+    };
+
+    // Task of a group, bound to the group as is: its frame completes into this slot,
+    // which reports to State through child_completed(index) / child_stopped(index),
+    // instead of resuming a continuation. The group costs no frame besides the tasks.
+    template<typename State, typename T>
+    class [[nodiscard]] join_child : private completion_slot
+    {
+    public:
+        using handle_type = task<T>::handle_type;
+
+        explicit join_child(task<T>&& child) noexcept :
+            completion_slot{ &join_child::complete_child },
+            handle(std::exchange(child.handle, nullptr))
+        {}
+
+        join_child(const join_child&) = delete;
+        join_child& operator=(const join_child&) = delete;
+
+        // only before bind()
+        join_child(join_child&& other) noexcept :
+            completion_slot{ &join_child::complete_child },
+            handle(std::exchange(other.handle, nullptr))
+        {}
+
+        ~join_child() {
+            if (handle != nullptr) {
+                handle.destroy();
+            }
+        }
+
+        // Inherit env from parent and attach to the group, resume() starts it afterwards.
+        template<typename Promise>
+        void bind(State& state, std::size_t index, std::coroutine_handle<Promise> parent) noexcept {
+            this->state = std::addressof(state);
+            this->index = index;
+            handle.promise().set_completion_slot(*this, parent);
+        }
+
+        task<T>::promise_type& promise() const noexcept { return handle.promise(); }
+
+        void resume() const { handle.resume(); }
+
+        T result() { return handle.promise().result_promise().result(); }
+
+    private:
+        // the result, or the exception, is read through `handle` later
+        static std::coroutine_handle<> complete_child(completion_slot& slot, std::coroutine_handle<>,
+            const std::exception_ptr*, bool stopped) noexcept {
+            join_child& self = static_cast<join_child&>(slot);
+            return stopped ? self.state->child_stopped(self.index) : self.state->child_completed(self.index);
+        }
+
+        handle_type handle = nullptr;
+        State* state = nullptr;
+        std::size_t index = 0;
+    };
+
+} // namespace cocoro::details
+
+#endif // COCORO_UTILITYS_JOIN_H
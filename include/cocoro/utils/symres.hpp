@@ -4,6 +4,7 @@
 
 #include <concepts>
 #include <exception>
+#include <memory>
 
 #include "./basic.hpp"
 
@@ -15,6 +16,8 @@ namespace cocoro::details {
     public:
         enum class status : unsigned char {
             uninitilized, value, exception,
+            // tail calls, the slot holds a link to another frame instead of a result
+            tail_head, tail_link,
         };
 
         symmetric_result_base() = default;
@@ -22,7 +25,7 @@ namespace cocoro::details {
         void unhandled_exception() noexcept {
             auto& self = this->self();
             self.reset();
-            self.storage.exception = std::current_exception();
+            new (std::addressof(self.storage.exception)) std::exception_ptr(std::current_exception());
             self.state = status::exception;
         }
 
@@ -37,6 +40,12 @@ namespace cocoro::details {
             return this->self().state;
         }
 
+        // Exception held, null if none.
+        const std::exception_ptr* stored_exception() const noexcept {
+            const auto& self = this->self();
+            return self.state == status::exception ? std::addressof(self.storage.exception) : nullptr;
+        }
+
     private:
         Derived& self() noexcept {
             return static_cast<Derived&>(*this);
@@ -106,11 +115,23 @@ namespace cocoro {
             }
         }
 
+        // Inspect the value in place, state() must be status::value.
+        data_type& stored_value() noexcept { return this->storage.value; }
+
+        void set_link(status tag, void* link) noexcept {
+            this->reset();
+            this->storage.link = link;
+            this->state = tag;
+        }
+
+        void* link() const noexcept { return this->storage.link; }
+
     private:
         union storage_type {
             details::monostate dummy;
             data_type value;
             std::exception_ptr exception;
+            void* link;
 
             storage_type() noexcept : dummy{} {}
             ~storage_type() {}
@@ -151,10 +172,19 @@ namespace cocoro {
             this->throw_if_exception();
         }
 
+        void set_link(status tag, void* link) noexcept {
+            this->reset();
+            this->storage.link = link;
+            this->state = tag;
+        }
+
+        void* link() const noexcept { return this->storage.link; }
+
     private:
         union storage_type {
             details::monostate dummy;
             std::exception_ptr exception;
+            void* link;
 
             storage_type() noexcept : dummy{} {}
             ~storage_type() {}
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef COCORO_UTILITYS_WAITER_H
+#define COCORO_UTILITYS_WAITER_H 1
+
+#include <coroutine>
+#include <utility>
+
+#include "cocoro/utils/basic.hpp"
+#include "cocoro/env/affine.hpp"
+
+namespace cocoro::details {
+
+    // Intrusive node of a suspended coroutine, lives in its awaiter.
+    // Linked into lock-free LIFO stacks by the synchronization primitives.
+    struct alignas(2) waiter_node : private pinned
+    {
+        waiter_node* next = nullptr;
+        std::coroutine_handle<> handle = nullptr;
+        scheduler_ref home = {};
+
+        template<typename Promise>
+        void prepare(std::coroutine_handle<Promise> suspending) noexcept {
+            handle = suspending;
+            home = home_scheduler(suspending);
+        }
+
+        // Resume on the scheduler of its env, the node is gone afterwards.
+        void wake() noexcept;
+    };
+
+    // Inline wakes made while one is being resumed are queued and resumed by the outermost,
+    // so a chain of handoffs, e.g. an unlock waking a coroutine that unlocks again,
+    // runs in a loop instead of nesting one resumption per waiter on the stack.
+    class inline_wake_queue
+    {
+    public:
+        static void wake(waiter_node& node) noexcept {
+            node.next = nullptr;
+            if (draining) {
+                (tail != nullptr ? tail->next : head) = &node;
+                tail = &node;
+                return;
+            }
+            draining = true;
+            node.handle.resume();
+            while (head != nullptr) {
+                waiter_node* next = std::exchange(head, head->next);
+                if (head == nullptr) {
+                    tail = nullptr;
+                }
+                next->handle.resume();
+            }
+            draining = false;
+        }
+
+    private:
+        static inline thread_local constinit bool draining = false;
+        static inline thread_local constinit waiter_node* head = nullptr;
+        static inline thread_local constinit waiter_node* tail = nullptr;
+    };
+
+    inline void waiter_node::wake() noexcept {
+        const scheduler_ref sched = home;
+        if (sched.is_inline()) {
+            inline_wake_queue::wake(*this);
+        } else {
+            sched.post(handle);
+        }
+    }
+
+    // Wake every node of a stack, `next` is read before the node goes away.
+    inline void wake_all(waiter_node* node) noexcept {
+        while (node != nullptr) {
+            waiter_node* next = node->next;
+            node->wake();
+            node = next;
+        }
+    }
+
+} // namespace cocoro::details
+
+#endif // COCORO_UTILITYS_WAITER_H
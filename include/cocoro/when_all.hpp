@@ -0,0 +1,162 @@
+#pragma once
+#ifndef COCORO_WHEN_ALL_H
+#define COCORO_WHEN_ALL_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "cocoro/utils/join.hpp"
+#include "cocoro/task.hpp"
+
+namespace cocoro {
+
+    // Awaitable of cocoro::when_all(task<Ts>...)
+    // Join state lives in the awaiter, i.e. in the frame of the awaiting coroutine.
+    template<typename... Ts>
+    class [[nodiscard]] when_all_awaiter : private details::pinned
+    {
+    public:
+        using result_type = std::tuple<details::join_result_t<Ts>...>;
+
+        explicit when_all_awaiter(task<Ts>&&... tasks) :
+            children(std::move(tasks)...)
+        {}
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> parent) {
+            state.set_parent(parent);
+            std::apply([&](auto&... child) {
+                std::size_t index = 0;
+                (child.bind(*this, index++, parent), ...);
+                (child.resume(), ...);
+            }, children);
+            return finish();
+        }
+
+        result_type await_resume() {
+            return std::apply([](auto&... child) {
+                return result_type{ take(child)... };
+            }, children);
+        }
+
+        std::coroutine_handle<> child_completed(std::size_t) noexcept {
+            return finish();
+        }
+
+        std::coroutine_handle<> child_stopped(std::size_t) noexcept {
+            stopped.store(true, std::memory_order_relaxed);
+            return finish();
+        }
+
+    private:
+        std::coroutine_handle<> finish() noexcept {
+            if (!state.arrive()) {
+                return std::noop_coroutine();
+            }
+            return state.complete(stopped.load(std::memory_order_relaxed));
+        }
+
+        template<typename T>
+        static details::join_result_t<T> take(details::join_child<when_all_awaiter, T>& child) {
+            if constexpr (std::is_void_v<T>) {
+                child.result();
+                return {};
+            } else {
+                return child.result();
+            }
+        }
+
+        details::join_state state{ sizeof...(Ts) };
+        std::atomic<bool> stopped = false;
+        std::tuple<details::join_child<when_all_awaiter, Ts>...> children;
+    };
+
+    // Awaitable of cocoro::when_all(std::vector<task<T>>)
+    template<typename T>
+    class [[nodiscard]] when_all_range_awaiter : private details::pinned
+    {
+        using child_type = details::join_child<when_all_range_awaiter, T>;
+    public:
+        using result_type = std::conditional_t<std::is_void_v<T>, void, std::vector<details::join_result_t<T>>>;
+
+        explicit when_all_range_awaiter(std::vector<task<T>> tasks) :
+            state(tasks.size())
+        {
+            children.reserve(tasks.size());
+            for (task<T>& t : tasks) {
+                children.emplace_back(std::move(t));
+            }
+        }
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> parent) {
+            state.set_parent(parent);
+            for (std::size_t index = 0; child_type& child : children) {
+                child.bind(*this, index++, parent);
+            }
+            for (child_type& child : children) {
+                child.resume();
+            }
+            return finish();
+        }
+
+        result_type await_resume() {
+            if constexpr (std::is_void_v<T>) {
+                for (child_type& child : children) {
+                    child.result();
+                }
+            } else {
+                result_type results;
+                results.reserve(children.size());
+                for (child_type& child : children) {
+                    results.emplace_back(child.result());
+                }
+                return results;
+            }
+        }
+
+        std::coroutine_handle<> child_completed(std::size_t) noexcept {
+            return finish();
+        }
+
+        std::coroutine_handle<> child_stopped(std::size_t) noexcept {
+            stopped.store(true, std::memory_order_relaxed);
+            return finish();
+        }
+
+    private:
+        std::coroutine_handle<> finish() noexcept {
+            if (!state.arrive()) {
+                return std::noop_coroutine();
+            }
+            return state.complete(stopped.load(std::memory_order_relaxed));
+        }
+
+        details::join_state state;
+        std::atomic<bool> stopped = false;
+        std::vector<child_type> children;
+    };
+
+    // co_await the result to run all tasks concurrently and collect their results.
+    // The first exception, in argument order, is rethrown after every task completes.
+    // If any task stops, the awaiting coroutine is stopped as well.
+    template<typename... Ts>
+    when_all_awaiter<Ts...> when_all(task<Ts>... tasks) {
+        return when_all_awaiter<Ts...>(std::move(tasks)...);
+    }
+
+    template<typename T>
+    when_all_range_awaiter<T> when_all(std::vector<task<T>> tasks) {
+        return when_all_range_awaiter<T>(std::move(tasks));
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_WHEN_ALL_H
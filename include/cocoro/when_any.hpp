@@ -0,0 +1,221 @@
+#pragma once
+#ifndef COCORO_WHEN_ANY_H
+#define COCORO_WHEN_ANY_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <stop_token>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "cocoro/utils/join.hpp"
+#include "cocoro/env/stop_token.hpp"
+#include "cocoro/task.hpp"
+
+namespace cocoro::details {
+
+    // Stop state of a when_any group. Children observe the group token,
+    // which is stopped once a winner is picked or the awaiting coroutine is stopped.
+    class race_state : private pinned
+    {
+    public:
+        static constexpr std::size_t no_winner = static_cast<std::size_t>(-1);
+
+        std::inplace_stop_token get_token() const noexcept { return source.get_token(); }
+
+        template<typename Promise>
+        void forward_stop_from(std::coroutine_handle<Promise> parent) noexcept {
+            if constexpr (env::env_aware<Promise>) {
+                parent_callback.emplace(env::get_stop_token(parent.promise().get_env()), forward_stop{ &source });
+            }
+        }
+
+        // First completion wins and stops the others.
+        void try_win(std::size_t index) noexcept {
+            std::size_t expected = no_winner;
+            if (winner.compare_exchange_strong(expected, index, std::memory_order_acq_rel)) {
+                source.request_stop();
+            }
+        }
+
+        std::size_t winner_index() const noexcept { return winner.load(std::memory_order_acquire); }
+
+    private:
+        struct forward_stop {
+            std::inplace_stop_source* source;
+            void operator()() const noexcept { source->request_stop(); }
+        };
+
+        std::inplace_stop_source source;
+        std::atomic<std::size_t> winner = no_winner;
+        // declared after source, so that it is unregistered first
+        std::optional<std::inplace_stop_callback<forward_stop>> parent_callback;
+    };
+
+} // namespace cocoro::details
+
+namespace cocoro {
+
+    // Awaitable of cocoro::when_any(task<Ts>...)
+    template<typename... Ts>
+    class [[nodiscard]] when_any_awaiter : private details::pinned
+    {
+    public:
+        using result_type = std::variant<details::join_result_t<Ts>...>;
+
+        explicit when_any_awaiter(task<Ts>&&... tasks) :
+            children(std::move(tasks)...)
+        {}
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> parent) {
+            state.set_parent(parent);
+            race.forward_stop_from(parent);
+            std::apply([&](auto&... child) {
+                std::size_t index = 0;
+                (child.bind(*this, index++, parent), ...);
+                (child.promise().get_mut_env().set_stop_token(race.get_token()), ...);
+                (child.resume(), ...);
+            }, children);
+            return finish();
+        }
+
+        // Result of the first completed task, its index is the index of the variant.
+        result_type await_resume() {
+            return take(std::index_sequence_for<Ts...>{});
+        }
+
+        std::coroutine_handle<> child_completed(std::size_t index) noexcept {
+            race.try_win(index);
+            return finish();
+        }
+
+        std::coroutine_handle<> child_stopped(std::size_t) noexcept {
+            return finish();
+        }
+
+    private:
+        // awaiting coroutine stops if nobody won, i.e. everyone stopped
+        std::coroutine_handle<> finish() noexcept {
+            if (!state.arrive()) {
+                return std::noop_coroutine();
+            }
+            return state.complete(race.winner_index() == details::race_state::no_winner);
+        }
+
+        template<std::size_t... Is>
+        result_type take(std::index_sequence<Is...>) {
+            const std::size_t winner = race.winner_index();
+            std::optional<result_type> result;
+            ((Is == winner ? (result.emplace(take_at<Is>()), true) : false) || ...);
+            return std::move(*result);
+        }
+
+        template<std::size_t I>
+        result_type take_at() {
+            auto& child = std::get<I>(children);
+            if constexpr (std::is_void_v<std::tuple_element_t<I, std::tuple<Ts...>>>) {
+                child.result();
+                return result_type(std::in_place_index<I>);
+            } else {
+                return result_type(std::in_place_index<I>, child.result());
+            }
+        }
+
+        details::join_state state{ sizeof...(Ts) };
+        details::race_state race;
+        std::tuple<details::join_child<when_any_awaiter, Ts>...> children;
+    };
+
+    // Awaitable of cocoro::when_any(std::vector<task<T>>)
+    template<typename T>
+    class [[nodiscard]] when_any_range_awaiter : private details::pinned
+    {
+        using child_type = details::join_child<when_any_range_awaiter, T>;
+    public:
+        using result_type = std::conditional_t<std::is_void_v<T>,
+            std::size_t, std::pair<std::size_t, details::join_result_t<T>>>;
+
+        explicit when_any_range_awaiter(std::vector<task<T>> tasks) :
+            state(tasks.size())
+        {
+            children.reserve(tasks.size());
+            for (task<T>& t : tasks) {
+                children.emplace_back(std::move(t));
+            }
+        }
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> parent) {
+            state.set_parent(parent);
+            race.forward_stop_from(parent);
+            for (std::size_t index = 0; child_type& child : children) {
+                child.bind(*this, index++, parent);
+                child.promise().get_mut_env().set_stop_token(race.get_token());
+            }
+            for (child_type& child : children) {
+                child.resume();
+            }
+            return finish();
+        }
+
+        // Index and result of the first completed task.
+        result_type await_resume() {
+            const std::size_t winner = race.winner_index();
+            if constexpr (std::is_void_v<T>) {
+                children[winner].result();
+                return winner;
+            } else {
+                return result_type(winner, children[winner].result());
+            }
+        }
+
+        std::coroutine_handle<> child_completed(std::size_t index) noexcept {
+            race.try_win(index);
+            return finish();
+        }
+
+        std::coroutine_handle<> child_stopped(std::size_t) noexcept {
+            return finish();
+        }
+
+    private:
+        // awaiting coroutine stops if nobody won, i.e. everyone stopped
+        std::coroutine_handle<> finish() noexcept {
+            if (!state.arrive()) {
+                return std::noop_coroutine();
+            }
+            return state.complete(race.winner_index() == details::race_state::no_winner);
+        }
+
+        details::join_state state;
+        details::race_state race;
+        std::vector<child_type> children;
+    };
+
+    // co_await the result to run all tasks concurrently and take the first to complete,
+    // either with a value or an exception. Other tasks are requested to stop through
+    // their env stop token and awaited before the awaiting coroutine resumes.
+    // If every task stops, the awaiting coroutine is stopped as well.
+    template<typename... Ts>
+        requires (sizeof...(Ts) > 0)
+    when_any_awaiter<Ts...> when_any(task<Ts>... tasks) {
+        return when_any_awaiter<Ts...>(std::move(tasks)...);
+    }
+
+    // Range must not be empty.
+    template<typename T>
+    when_any_range_awaiter<T> when_any(std::vector<task<T>> tasks) {
+        return when_any_range_awaiter<T>(std::move(tasks));
+    }
+
+} // namespace cocoro
+
+#endif // COCORO_WHEN_ANY_H
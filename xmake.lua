@@ -1,20 +1,99 @@
 add_rules("mode.debug", "mode.release")
 set_languages("c++26")
 set_encodings("utf-8")
-add_files("src/*.cpp")
 add_includedirs("include")
 add_rules("plugin.compile_commands.autoupdate", {outputdir = ".vscode"})
 
-target("gnu")
-    set_kind("binary")
+-- `xmake f --trace=n` strips corotrace support from task frames and awaits
+option("trace")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Record coroutine suspension points for corotrace")
+option_end()
+
+if not has_config("trace") then
+    add_defines("COCORO_DISABLE_TRACE")
+end
+
+-- `xmake f --profiler=y` lets cocoro/profiler.hpp sample corotrace chains, needs trace
+option("profiler")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Report running coroutines to the sampling profiler")
+option_end()
+
+if has_config("profiler") then
+    add_defines("COCORO_ENABLE_PROFILER")
+end
+
+-- `xmake f --metrics=y` records task lifecycle histograms, read with cocoro::snapshot_task_metrics()
+option("metrics")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Record per task latency and lifecycle metrics")
+option_end()
+
+if has_config("metrics") then
+    add_defines("COCORO_ENABLE_METRICS")
+end
+
+-- `xmake f --corotrace_dump=y` registers live frames for cocoro::dump_all_corotraces(), needs trace
+option("corotrace_dump")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Keep a registry of live coroutines for corotrace dumps")
+option_end()
+
+if has_config("corotrace_dump") then
+    add_defines("COCORO_ENABLE_COROTRACE_DUMP")
+end
+
+local function gnu_toolchain()
     set_toolchains("gcc")
     set_runtimes("stdc++_shared")
     add_linkdirs("/usr/local/lib/../lib64")
     add_rpathdirs("/usr/local/lib/../lib64")
+end
 
-target("llvm")
-    set_kind("binary")
+local function llvm_toolchain()
     set_toolchains("clang")
     set_runtimes("c++_shared")
     add_linkdirs("/usr/local/lib/x86_64-unknown-linux-gnu")
     add_rpathdirs("/usr/local/lib/x86_64-unknown-linux-gnu")
+end
+
+target("gnu")
+    set_kind("binary")
+    add_files("src/*.cpp")
+    gnu_toolchain()
+
+target("llvm")
+    set_kind("binary")
+    add_files("src/*.cpp")
+    llvm_toolchain()
+
+-- benchmarks, run with `xmake run bench-gnu [filter]`, or `xmake run bench [filter]` for both toolchains
+target("bench-gnu")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/*.cpp")
+    gnu_toolchain()
+
+target("bench-llvm")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/*.cpp")
+    llvm_toolchain()
+
+target("bench")
+    set_kind("phony")
+    set_default(false)
+    add_deps("bench-gnu", "bench-llvm")
+    on_run(function (target)
+        import("core.base.option")
+        local args = option.get("arguments") or {}
+        for _, name in ipairs({"bench-gnu", "bench-llvm"}) do
+            cprint("${bright}== %s", name)
+            os.execv(target:dep(name):targetfile(), args)
+        end
+    end)